@@ -4751,7 +4751,16 @@ RGFW_event* RGFW_window_checkEvent(RGFW_window* win) {
 		win->event.type = RGFW_focusOut;
 		RGFW_focusCallback(win, 0);
 		break;
-	case PropertyNotify: RGFW_window_checkMode(win); break;
+	case PropertyNotify: {
+		/* only the window state can change the mode; skipping the rest (like
+		   the clipboard helper window's properties) saves two
+		   XGetWindowProperty round trips and their allocations */
+		RGFW_LOAD_ATOM(_NET_WM_STATE);
+		RGFW_LOAD_ATOM(WM_STATE);
+		if (E.xproperty.atom == _NET_WM_STATE || E.xproperty.atom == WM_STATE)
+			RGFW_window_checkMode(win);
+		break;
+	}
 	case EnterNotify: {
 		win->event.type = RGFW_mouseEnter;
 		win->event.point.x = E.xcrossing.x;
@@ -0,0 +1,92 @@
+// Steady-state allocation check (`--check-alloc FRAMES`). Runs the window for
+// a warm-up of ALLOC_CHECK_WARMUP_FRAMES, which covers the first title update
+// and the first second boundary, then for FRAMES more frames, and fails if the
+// render thread allocated during any of them. Allocations are attributed to
+// the phase of the frame they happened in. The counter comes from the
+// build/alloccount.so LD_PRELOAD shim, found through a weak reference.
+
+#define ALLOC_CHECK_WARMUP_FRAMES (2 * FPS)
+
+extern uint64_t alloccount_thread_allocations(void) __attribute__((weak));
+
+typedef enum {
+    ALLOC_PHASE_EVENTS = 0,
+    ALLOC_PHASE_RENDER,
+    ALLOC_PHASE_SWAP,
+    ALLOC_PHASE_STATE,
+    ALLOC_PHASE_PACING,
+    COUNT_ALLOC_PHASES,
+} Alloc_Phase;
+
+static const char *alloc_phase_names[COUNT_ALLOC_PHASES] = {
+    [ALLOC_PHASE_EVENTS] = "events",
+    [ALLOC_PHASE_RENDER] = "render",
+    [ALLOC_PHASE_SWAP]   = "swap",
+    [ALLOC_PHASE_STATE]  = "state",
+    [ALLOC_PHASE_PACING] = "pacing",
+};
+
+typedef struct {
+    int active;
+    size_t frames;
+    size_t target_frames;
+    uint64_t last_count;
+    uint64_t phases[COUNT_ALLOC_PHASES];
+    size_t dirty_frames; // steady-state frames with at least one allocation
+    uint64_t frame_start_count;
+} Alloc_Check;
+
+static Alloc_Check alloc_check = {0};
+
+bool alloc_check_begin(size_t frames) {
+    if (!alloccount_thread_allocations) {
+        fprintf(stderr, "ERROR: --check-alloc needs the counting allocator, run it as LD_PRELOAD=build/alloccount.so ./timer --check-alloc %zu\n", frames);
+        return false;
+    }
+    alloc_check.active = 1;
+    alloc_check.target_frames = ALLOC_CHECK_WARMUP_FRAMES + frames;
+    alloc_check.last_count = alloccount_thread_allocations();
+    alloc_check.frame_start_count = alloc_check.last_count;
+    return true;
+}
+
+// Attributes the allocations since the previous mark to the phase that just ended
+void alloc_check_mark(Alloc_Phase phase) {
+    if (!alloc_check.active) return;
+    uint64_t count = alloccount_thread_allocations();
+    if (alloc_check.frames >= ALLOC_CHECK_WARMUP_FRAMES) alloc_check.phases[phase] += count - alloc_check.last_count;
+    alloc_check.last_count = count;
+}
+
+// Returns true once enough frames were checked
+bool alloc_check_end_frame(void) {
+    if (!alloc_check.active) return false;
+    alloc_check_mark(ALLOC_PHASE_PACING);
+    if (alloc_check.frames >= ALLOC_CHECK_WARMUP_FRAMES && alloc_check.last_count != alloc_check.frame_start_count) {
+        alloc_check.dirty_frames++;
+    }
+    alloc_check.frame_start_count = alloc_check.last_count;
+    alloc_check.frames++;
+    return alloc_check.frames >= alloc_check.target_frames;
+}
+
+// Prints the result, returns the exit status of the check
+int alloc_check_report(void) {
+    if (!alloc_check.active) return 0;
+    size_t checked = alloc_check.frames > ALLOC_CHECK_WARMUP_FRAMES ? alloc_check.frames - ALLOC_CHECK_WARMUP_FRAMES : 0;
+    uint64_t total = 0;
+    for (size_t i = 0; i < COUNT_ALLOC_PHASES; ++i) total += alloc_check.phases[i];
+
+    printf("allocation check: %llu allocations in %zu of %zu steady-state frames\n",
+           (unsigned long long) total, alloc_check.dirty_frames, checked);
+    for (size_t i = 0; i < COUNT_ALLOC_PHASES; ++i) {
+        printf("  %-8s %llu\n", alloc_phase_names[i], (unsigned long long) alloc_check.phases[i]);
+    }
+    if (checked + ALLOC_CHECK_WARMUP_FRAMES < alloc_check.target_frames) {
+        printf("FAIL: the window was closed after %zu of %zu frames\n", checked,
+               alloc_check.target_frames - ALLOC_CHECK_WARMUP_FRAMES);
+        return 1;
+    }
+    printf("%s\n", total == 0 ? "OK" : "FAIL: the steady-state loop allocates");
+    return total == 0 ? 0 : 1;
+}
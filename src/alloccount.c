@@ -0,0 +1,58 @@
+// LD_PRELOAD shim that counts heap allocations per thread for `--check-alloc`:
+//
+//     make build/alloccount.so
+//     LD_PRELOAD=build/alloccount.so ./timer --check-alloc 5000
+//
+// Every allocating entry point forwards to glibc's __libc_* implementation,
+// so there is no dlsym(RTLD_NEXT) bootstrapping that could itself allocate.
+// free is left alone, only the number of allocations matters.
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+// initial-exec so that touching the counter never allocates a TLS block
+static __thread uint64_t thread_allocations __attribute__((tls_model("initial-exec")));
+
+uint64_t alloccount_thread_allocations(void) {
+    return thread_allocations;
+}
+
+void *malloc(size_t size) {
+    thread_allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    thread_allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    thread_allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    thread_allocations++;
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    thread_allocations++;
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **result, size_t alignment, size_t size) {
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) return EINVAL;
+    thread_allocations++;
+    void *ptr = __libc_memalign(alignment, size);
+    if (!ptr) return ENOMEM;
+    *result = ptr;
+    return 0;
+}
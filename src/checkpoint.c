@@ -0,0 +1,214 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Crash-safe state file. The file holds two checksummed records; every
+// write goes to the slot that does NOT hold the newest record, so a write
+// torn by a crash or a power cut always leaves the previous one intact.
+// The file is mmap'ed MAP_SHARED, so a killed process loses nothing and the
+// kernel writes the pages back on its own schedule (no fsync in the loop).
+// A record only applies to the command line that wrote it: it carries a hash
+// of the arguments, and a different invocation starts fresh.
+
+#define CHECKPOINT_MAGIC 0x54494d52 // "TIMR"
+#define CHECKPOINT_VERSION 2
+#define BOOT_ID_CAP 40
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seq;
+    int32_t mode;
+    int32_t paused;
+    int32_t exit_after_countdown;
+    uint32_t args_hash;         // checkpoint_args_hash of the command line that wrote it
+    double displayed_time;      // value of State.displayed_time at the anchor
+    int64_t anchor_realtime_ns; // CLOCK_REALTIME at the anchor, used across reboots
+    int64_t anchor_boottime_ns; // CLOCK_BOOTTIME at the anchor, used within one boot
+    char boot_id[BOOT_ID_CAP];
+    uint32_t checksum;
+    uint32_t reserved2;
+} Checkpoint_Record;
+
+typedef struct {
+    Checkpoint_Record slots[2];
+} Checkpoint_File;
+
+typedef struct {
+    int fd;
+    Checkpoint_File *file;
+    Checkpoint_Record last; // newest record, valid when last.seq != 0
+    char boot_id[BOOT_ID_CAP];
+    uint32_t args_hash;
+} Checkpoint;
+
+static Checkpoint checkpoint = {.fd = -1};
+
+// FNV-1a over everything that precedes the checksum field
+static uint32_t checkpoint_checksum(const Checkpoint_Record *record) {
+    const unsigned char *bytes = (const unsigned char *)record;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(Checkpoint_Record, checksum); ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// FNV-1a over the arguments, each one terminated by its NUL
+static uint32_t checkpoint_args_hash(int argc, char **argv) {
+    uint32_t hash = 2166136261u;
+    for (int i = 1; i < argc; ++i) {
+        for (const unsigned char *c = (const unsigned char *)argv[i];; ++c) {
+            hash ^= *c;
+            hash *= 16777619u;
+            if (*c == '\0') break;
+        }
+    }
+    return hash;
+}
+
+static bool checkpoint_record_valid(const Checkpoint_Record *record) {
+    return record->magic == CHECKPOINT_MAGIC
+        && record->version == CHECKPOINT_VERSION
+        && record->seq != 0
+        && record->checksum == checkpoint_checksum(record);
+}
+
+static void read_boot_id(char *boot_id) {
+    memset(boot_id, 0, BOOT_ID_CAP);
+    FILE *f = fopen("/proc/sys/kernel/random/boot_id", "r");
+    if (!f) return;
+    if (!fgets(boot_id, BOOT_ID_CAP, f)) boot_id[0] = '\0';
+    fclose(f);
+}
+
+bool checkpoint_open(const char *path, int argc, char **argv) {
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: could not open state file `%s`: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (st.st_size != sizeof(Checkpoint_File) && ftruncate(fd, sizeof(Checkpoint_File)) < 0)) {
+        fprintf(stderr, "ERROR: could not size state file `%s`: %s\n", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    void *mem = mmap(NULL, sizeof(Checkpoint_File), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        fprintf(stderr, "ERROR: could not map state file `%s`: %s\n", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    checkpoint.fd = fd;
+    checkpoint.file = mem;
+    read_boot_id(checkpoint.boot_id);
+    checkpoint.args_hash = checkpoint_args_hash(argc, argv);
+
+    memset(&checkpoint.last, 0, sizeof(checkpoint.last));
+    for (size_t i = 0; i < 2; ++i) {
+        const Checkpoint_Record *record = &checkpoint.file->slots[i];
+        if (checkpoint_record_valid(record) && record->seq > checkpoint.last.seq) {
+            checkpoint.last = *record;
+        }
+    }
+    return true;
+}
+
+// Where the anchored record says displayed_time should be right now
+static double checkpoint_predict(const Checkpoint_Record *record, int64_t realtime_ns, int64_t boottime_ns) {
+    if (record->paused || record->mode == MODE_CLOCK) return record->displayed_time;
+
+    int64_t elapsed_ns;
+    if (checkpoint.boot_id[0] && strcmp(record->boot_id, checkpoint.boot_id) == 0) {
+        elapsed_ns = boottime_ns - record->anchor_boottime_ns;
+    } else {
+        elapsed_ns = realtime_ns - record->anchor_realtime_ns;
+    }
+    if (elapsed_ns < 0) elapsed_ns = 0;
+
+    double elapsed = (double)elapsed_ns / 1e9;
+    if (record->mode == MODE_COUNTDOWN) {
+        return fmax(record->displayed_time - elapsed, 0.0);
+    }
+    return record->displayed_time + elapsed;
+}
+
+// Restores the newest valid record into the state. Returns false if the file
+// had none, or only one that belongs to other arguments or has run out.
+bool checkpoint_restore(State *state) {
+    if (!checkpoint.file || checkpoint.last.seq == 0) return false;
+
+    const Checkpoint_Record *record = &checkpoint.last;
+    if (record->args_hash != checkpoint.args_hash) {
+        fprintf(stderr, "INFO: state file was written with other arguments, starting fresh\n");
+        return false;
+    }
+    double displayed_time = checkpoint_predict(record, clock_ns(CLOCK_REALTIME), clock_ns(CLOCK_BOOTTIME));
+    if (record->mode == MODE_COUNTDOWN && displayed_time <= 0.0) {
+        fprintf(stderr, "INFO: countdown in the state file has already expired, starting fresh\n");
+        return false;
+    }
+    state->mode = (Mode)record->mode;
+    state->paused = record->paused;
+    state->exit_after_countdown = record->exit_after_countdown;
+    state->displayed_time = displayed_time;
+    return true;
+}
+
+// Call once per frame. Writes only when the state departs from what the newest
+// record already predicts: pause/resume, mode switch, reset or a clock jump.
+void checkpoint_update(const State *state) {
+    if (!checkpoint.file) return;
+
+    const Checkpoint_Record *last = &checkpoint.last;
+    int64_t realtime_ns = clock_ns(CLOCK_REALTIME);
+    int64_t boottime_ns = clock_ns(CLOCK_BOOTTIME);
+
+    if (last->seq != 0
+        && last->mode == (int32_t)state->mode
+        && last->paused == state->paused
+        && last->exit_after_countdown == state->exit_after_countdown
+        && (state->mode == MODE_CLOCK
+            || fabs(checkpoint_predict(last, realtime_ns, boottime_ns) - state->displayed_time) < 1.0)) {
+        return;
+    }
+
+    Checkpoint_Record record = {0};
+    record.magic = CHECKPOINT_MAGIC;
+    record.version = CHECKPOINT_VERSION;
+    record.seq = last->seq + 1;
+    record.mode = state->mode;
+    record.paused = state->paused;
+    record.exit_after_countdown = state->exit_after_countdown;
+    record.args_hash = checkpoint.args_hash;
+    record.displayed_time = state->displayed_time;
+    record.anchor_realtime_ns = realtime_ns;
+    record.anchor_boottime_ns = boottime_ns;
+    memcpy(record.boot_id, checkpoint.boot_id, BOOT_ID_CAP);
+    record.checksum = checkpoint_checksum(&record);
+
+    checkpoint.file->slots[record.seq & 1] = record;
+    checkpoint.last = record;
+    // Kick off writeback without waiting for it
+    msync(checkpoint.file, sizeof(Checkpoint_File), MS_ASYNC);
+}
+
+void checkpoint_close(void) {
+    if (!checkpoint.file) return;
+    // Off the frame loop now, so it is fine to wait for the disk
+    msync(checkpoint.file, sizeof(Checkpoint_File), MS_SYNC);
+    munmap(checkpoint.file, sizeof(Checkpoint_File));
+    close(checkpoint.fd);
+    checkpoint.file = NULL;
+    checkpoint.fd = -1;
+}
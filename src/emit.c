@@ -0,0 +1,125 @@
+// Machine-readable status stream on stdout for status bars (`--emit json|i3bar`).
+// A line is produced only when the displayed second, the paused flag or the mode
+// changes. stdout is switched to O_NONBLOCK and lines are queued in a fixed buffer,
+// so a consumer that stops reading can never stall the frame loop. When the queue
+// is full the stale lines are dropped (a status bar only cares about the newest one),
+// but a line that was already partially written is always completed first.
+
+#define EMIT_BUFFER_CAP 4096
+#define EMIT_LINE_CAP 256
+
+typedef struct {
+    int active;
+    int saved_flags;
+    char buffer[EMIT_BUFFER_CAP];
+    size_t head;  // first byte not yet written
+    size_t size;  // bytes queued after head
+    long long last_seconds;
+    int last_paused;
+    Mode last_mode;
+    size_t dropped_lines;
+} Emit;
+
+static Emit emit = {0};
+
+static void emit_flush(void) {
+    while (emit.size > 0) {
+        ssize_t n = write(STDOUT_FILENO, emit.buffer + emit.head, emit.size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EPIPE) {
+                // nobody is listening anymore
+                emit.active = 0;
+                emit.size = 0;
+            }
+            return; // EAGAIN: try again next frame
+        }
+        emit.head += (size_t)n;
+        emit.size -= (size_t)n;
+    }
+    emit.head = 0;
+}
+
+static void emit_push(const char *line, size_t line_size) {
+    if (emit.head + emit.size + line_size > EMIT_BUFFER_CAP) {
+        // Keep only the rest of the line the consumer has already started reading
+        size_t keep = 0;
+        int started = emit.head > 0 && emit.buffer[emit.head - 1] != '\n';
+        if (started) {
+            const char *nl = memchr(emit.buffer + emit.head, '\n', emit.size);
+            keep = nl ? (size_t)(nl - (emit.buffer + emit.head)) + 1 : emit.size;
+        }
+        for (size_t i = keep; i < emit.size; ++i) {
+            if (emit.buffer[emit.head + i] == '\n') emit.dropped_lines++;
+        }
+        memmove(emit.buffer, emit.buffer + emit.head, keep);
+        emit.head = 0;
+        emit.size = keep;
+        if (emit.size + line_size > EMIT_BUFFER_CAP) return;
+    }
+    memcpy(emit.buffer + emit.head + emit.size, line, line_size);
+    emit.size += line_size;
+}
+
+static void emit_end(void) {
+    if (!emit.active) return;
+    emit_flush();
+    fcntl(STDOUT_FILENO, F_SETFL, emit.saved_flags);
+    emit.active = 0;
+}
+
+void emit_begin(Emit_Format format) {
+    if (format == EMIT_NONE) return;
+
+    emit.saved_flags = fcntl(STDOUT_FILENO, F_GETFL);
+    if (emit.saved_flags < 0) {
+        fprintf(stderr, "WARNING: could not query stdout, --emit disabled: %s\n", strerror(errno));
+        return;
+    }
+    fcntl(STDOUT_FILENO, F_SETFL, emit.saved_flags | O_NONBLOCK);
+    // A closed pipe must surface as EPIPE, not kill the timer
+    signal(SIGPIPE, SIG_IGN);
+
+    emit.active = 1;
+    emit.last_seconds = -1;
+    atexit(emit_end);
+
+    if (format == EMIT_I3BAR) {
+        const char header[] = "{\"version\":1}\n[\n";
+        emit_push(header, sizeof(header) - 1);
+        emit_flush();
+    }
+}
+
+// Call once per frame, cheap when nothing changed
+void emit_update(const State *state) {
+    if (!emit.active) return;
+
+    const long long t = (long long) floorf(fmaxf(state->displayed_time, 0.0f));
+    if (t != emit.last_seconds || state->paused != emit.last_paused || state->mode != emit.last_mode) {
+        emit.last_seconds = t;
+        emit.last_paused = state->paused;
+        emit.last_mode = state->mode;
+
+        char hms[32];
+        snprintf(hms, sizeof(hms), "%02lld:%02lld:%02lld", t / 60 / 60, t / 60 % 60, t % 60);
+
+        char line[EMIT_LINE_CAP];
+        int n;
+        if (state->emit == EMIT_I3BAR) {
+            int r = state->paused ? PAUSE_COLOR_R : MAIN_COLOR_R;
+            int g = state->paused ? PAUSE_COLOR_G : MAIN_COLOR_G;
+            int b = state->paused ? PAUSE_COLOR_B : MAIN_COLOR_B;
+            n = snprintf(line, sizeof(line),
+                         "[{\"name\":\"timer\",\"instance\":\"%s\",\"full_text\":\"%s\",\"color\":\"#%02X%02X%02X\"}],\n",
+                         mode_as_cstr(state->mode), hms, r, g, b);
+        } else {
+            n = snprintf(line, sizeof(line),
+                         "{\"time\":\"%s\",\"seconds\":%lld,\"paused\":%s,\"mode\":\"%s\"}\n",
+                         hms, t, state->paused ? "true" : "false", mode_as_cstr(state->mode));
+        }
+        if (n > 0 && n < (int) sizeof(line)) emit_push(line, (size_t) n);
+    }
+
+    emit_flush();
+}
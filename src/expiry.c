@@ -0,0 +1,254 @@
+#include <pthread.h>
+#include <spawn.h>
+#include <stdatomic.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+
+// Countdown expiry on an absolute timerfd, serviced by its own
+// thread so the completion hooks fire on time no matter how slowly frames run.
+// The frame loop only re-arms the timer when the countdown changes (pause,
+// reset, ...) and picks up the expiry to snap the displayed time to zero.
+// The timer runs on the clock of the suspend policy, so a countdown that counts
+// suspended time also expires on schedule across a suspend.
+
+#define EXPIRY_REARM_THRESHOLD_NS (50 * 1000000LL)
+#define EXPIRY_HOOKS_CAP 16
+
+extern char **environ;
+
+typedef struct {
+    int fd;
+    clockid_t clock;
+    pthread_t thread;
+    int running;
+
+    _Atomic int64_t armed_deadline_ns; // 0 when disarmed
+    _Atomic int fired;                  // set by the thread, consumed by expiry_update
+    atomic_int firing;                  // from claiming a deadline until its hooks and lateness are done
+    _Atomic int64_t last_lateness_ns;
+    atomic_int quit;
+
+    const char *cmd;
+    const char *fifo;
+    pid_t signal_pid;
+    int signal_number;
+
+    pid_t hooks[EXPIRY_HOOKS_CAP]; // spawned --on-expire commands not reaped yet, expiry thread only
+    size_t hooks_count;
+} Expiry;
+
+static Expiry expiry = {.fd = -1};
+
+// Reaps only the hooks spawned here, other children belong to other code
+static void expiry_reap_hooks(void) {
+    size_t kept = 0;
+    for (size_t i = 0; i < expiry.hooks_count; ++i) {
+        if (waitpid(expiry.hooks[i], NULL, WNOHANG) == 0) expiry.hooks[kept++] = expiry.hooks[i];
+    }
+    expiry.hooks_count = kept;
+}
+
+static void expiry_run_hooks(int64_t deadline_ns, int64_t fired_ns) {
+    if (expiry.cmd) {
+        char *const args[] = {"/bin/sh", "-c", (char *) expiry.cmd, NULL};
+        pid_t pid;
+        // The window loop blocks SIGUSR1/SIGUSR2 for its signalfd, the hook must not inherit that
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        sigset_t none;
+        sigemptyset(&none);
+        posix_spawnattr_setsigmask(&attr, &none);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+        int err = posix_spawn(&pid, "/bin/sh", NULL, &attr, args, environ);
+        posix_spawnattr_destroy(&attr);
+        if (err != 0) {
+            fprintf(stderr, "ERROR: could not spawn `%s`: %s\n", expiry.cmd, strerror(err));
+        } else if (expiry.hooks_count < EXPIRY_HOOKS_CAP) {
+            expiry.hooks[expiry.hooks_count++] = pid;
+        } else {
+            fprintf(stderr, "WARNING: too many `%s` still running, pid %d is left for exit to reap\n", expiry.cmd, (int) pid);
+        }
+    }
+    if (expiry.fifo) {
+        // O_NONBLOCK: a FIFO nobody reads must not hold the hook thread hostage
+        int fd = open(expiry.fifo, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd >= 0) {
+            char line[128];
+            int n = snprintf(line, sizeof(line), "expired %lld %lld\n", (long long) deadline_ns, (long long) fired_ns);
+            if (write(fd, line, (size_t) n) < 0) fprintf(stderr, "ERROR: could not write to `%s`: %s\n", expiry.fifo, strerror(errno));
+            close(fd);
+        } else {
+            fprintf(stderr, "ERROR: could not open `%s`: %s\n", expiry.fifo, strerror(errno));
+        }
+    }
+    if (expiry.signal_pid > 0) {
+        if (kill(expiry.signal_pid, expiry.signal_number) < 0) {
+            fprintf(stderr, "ERROR: could not signal pid %d: %s\n", (int) expiry.signal_pid, strerror(errno));
+        }
+    }
+}
+
+static void *expiry_thread(void *arg) {
+    (void) arg;
+    while (!atomic_load(&expiry.quit)) {
+        uint64_t expirations;
+        ssize_t n = read(expiry.fd, &expirations, sizeof(expirations));
+        expiry_reap_hooks();
+        if (n != sizeof(expirations)) continue;
+        if (atomic_load(&expiry.quit)) break;
+
+        int64_t fired_ns = clock_ns(expiry.clock);
+        int64_t deadline_ns = atomic_load(&expiry.armed_deadline_ns);
+        // re-armed or disarmed between the expiry and this read
+        if (deadline_ns == 0 || fired_ns < deadline_ns) continue;
+        // raised before the deadline is cleared, so expiry_wait always sees one of the two
+        atomic_store(&expiry.firing, 1);
+        if (!atomic_compare_exchange_strong(&expiry.armed_deadline_ns, &deadline_ns, 0)) {
+            atomic_store(&expiry.firing, 0);
+            continue;
+        }
+
+        expiry_run_hooks(deadline_ns, fired_ns);
+        atomic_store(&expiry.last_lateness_ns, fired_ns - deadline_ns);
+        atomic_store(&expiry.fired, 1);
+        atomic_store(&expiry.firing, 0);
+    }
+    return NULL;
+}
+
+static void expiry_arm(int64_t deadline_ns) {
+    atomic_store(&expiry.armed_deadline_ns, deadline_ns);
+    struct itimerspec its = {0};
+    its.it_value.tv_sec = deadline_ns / 1000000000;
+    its.it_value.tv_nsec = deadline_ns % 1000000000;
+    timerfd_settime(expiry.fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void expiry_disarm(void) {
+    atomic_store(&expiry.armed_deadline_ns, 0);
+    struct itimerspec its = {0};
+    timerfd_settime(expiry.fd, 0, &its, NULL);
+}
+
+bool expiry_begin(const State *state) {
+    expiry.cmd = state->on_expire_cmd;
+    expiry.fifo = state->on_expire_fifo;
+    expiry.signal_pid = state->on_expire_pid;
+    expiry.signal_number = state->on_expire_signal;
+
+    expiry.clock = suspend_policy_clock(state->suspend);
+    expiry.fd = timerfd_create(expiry.clock, TFD_CLOEXEC);
+    if (expiry.fd < 0) {
+        fprintf(stderr, "ERROR: could not create expiry timer: %s\n", strerror(errno));
+        return false;
+    }
+    int err = pthread_create(&expiry.thread, NULL, expiry_thread, NULL);
+    if (err != 0) {
+        fprintf(stderr, "ERROR: could not start expiry thread: %s\n", strerror(err));
+        close(expiry.fd);
+        expiry.fd = -1;
+        return false;
+    }
+    expiry.running = 1;
+    return true;
+}
+
+// Call once per frame after state_update
+void expiry_update(State *state) {
+    if (!expiry.running) return;
+
+    if (atomic_exchange(&expiry.fired, 0) && state->mode == MODE_COUNTDOWN) {
+        state->displayed_time = 0.0f;
+    }
+
+    int64_t armed_ns = atomic_load(&expiry.armed_deadline_ns);
+    if (state->mode != MODE_COUNTDOWN || state->paused) {
+        if (armed_ns != 0) expiry_disarm();
+        return;
+    }
+    // Once the displayed time reaches zero an armed timer is left to fire on its own
+    if (state->displayed_time <= 1e-6f) return;
+
+    int64_t want_ns = clock_ns(expiry.clock) + (int64_t) ((double) state->displayed_time * 1e9);
+    if (armed_ns == 0 || llabs(want_ns - armed_ns) > EXPIRY_REARM_THRESHOLD_NS) {
+        expiry_arm(want_ns);
+    }
+}
+
+// Blocks until an armed expiry has fired and its hooks have run, so they run
+// before the process exits and last_lateness_ns is final
+void expiry_wait(void) {
+    if (!expiry.running) return;
+    for (int i = 0; i < 1000 && (atomic_load(&expiry.armed_deadline_ns) != 0 || atomic_load(&expiry.firing)); ++i) {
+        struct timespec ts = {0, 1000000};
+        nanosleep(&ts, NULL);
+    }
+}
+
+void expiry_end(void) {
+    if (!expiry.running) return;
+    atomic_store(&expiry.quit, 1);
+    expiry_arm(1); // long in the past, wakes the thread up right away
+    pthread_join(expiry.thread, NULL);
+    close(expiry.fd);
+    expiry.fd = -1;
+    expiry.running = 0;
+}
+
+static int compare_int64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static void print_lateness(const char *label, int64_t *samples, size_t count) {
+    qsort(samples, count, sizeof(*samples), compare_int64);
+    double sum = 0;
+    for (size_t i = 0; i < count; ++i) sum += (double) samples[i];
+    printf("%-12s min %8.1fus  p50 %8.1fus  avg %8.1fus  p99 %8.1fus  max %8.1fus\n", label,
+           samples[0] / 1e3, samples[count / 2] / 1e3, sum / count / 1e3, samples[(count * 99) / 100] / 1e3, samples[count - 1] / 1e3);
+}
+
+// `--bench-expiry N`: arms N countdowns of 20..120ms while a loop paced like
+// the render loop polls for them, and compares how late each path notices.
+int expiry_bench(State *state, int runs) {
+    if (runs <= 0) return 1;
+    if (!expiry_begin(state)) return 1;
+
+    int64_t *timerfd_late = malloc(sizeof(int64_t) * runs);
+    int64_t *frame_late = malloc(sizeof(int64_t) * runs);
+    if (!timerfd_late || !frame_late) {
+        fprintf(stderr, "ERROR: could not allocate %d expiry bench samples\n", runs);
+        free(timerfd_late);
+        free(frame_late);
+        expiry_end();
+        return 1;
+    }
+    const int64_t frame_ns = 1000000000LL / FPS;
+
+    for (int i = 0; i < runs; ++i) {
+        int64_t deadline_ns = clock_ns(expiry.clock) + (20 + (i * 37) % 100) * 1000000LL;
+        atomic_store(&expiry.last_lateness_ns, -1);
+        expiry_arm(deadline_ns);
+
+        // What the old frame loop would see: the first frame start past the deadline
+        int64_t now_ns;
+        while ((now_ns = clock_ns(expiry.clock)) < deadline_ns) {
+            struct timespec ts = {0, frame_ns};
+            nanosleep(&ts, NULL);
+        }
+        frame_late[i] = now_ns - deadline_ns;
+
+        expiry_wait();
+        timerfd_late[i] = atomic_load(&expiry.last_lateness_ns);
+        atomic_store(&expiry.fired, 0);
+    }
+    expiry_end();
+
+    printf("expiry lateness over %d countdowns (%d FPS frame loop)\n", runs, FPS);
+    print_lateness("timerfd", timerfd_late, runs);
+    print_lateness("frame poll", frame_late, runs);
+
+    free(timerfd_late);
+    free(frame_late);
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Frame timing with an explicit suspend policy. `--suspend=count` measures
+// frames on CLOCK_BOOTTIME, so time spent suspended counts towards the timer;
+// `--suspend=pause` uses CLOCK_MONOTONIC, so the timer behaves as if paused
+// while the machine sleeps. Either way a resume is detected by comparing the
+// two clocks, and the slept time is reported separately from the awake dt so
+// the first frame after resume does not feed one giant step to state_update.
+//
+// The dt source itself is pluggable (`--clock`): the real clock, a fixed step,
+// a replay of dt values from a file (one per line, in seconds) or the real
+// clock while recording its dt values into such a file.
+
+#define SUSPEND_DETECT_THRESHOLD_NS (500 * 1000000LL)
+
+typedef enum {
+    SUSPEND_COUNT = 0,
+    SUSPEND_PAUSE,
+} Suspend_Policy;
+
+typedef enum {
+    CLOCK_SOURCE_REAL = 0,
+    CLOCK_SOURCE_FIXED,
+    CLOCK_SOURCE_REPLAY,
+    CLOCK_SOURCE_RECORD,
+} Clock_Source;
+
+typedef struct {
+    Clock_Source source;
+    float fixed_dt;   // CLOCK_SOURCE_FIXED
+    double fixed_step; // fixed_dt as written, before rounding to float
+    const char *path; // CLOCK_SOURCE_REPLAY and CLOCK_SOURCE_RECORD
+} Clock_Config;
+
+typedef struct {
+    Suspend_Policy policy;
+    Clock_Config config;
+    FILE *file;
+    int exhausted; // the replay ran out of dt values
+    int64_t last_monotonic_ns;
+    int64_t last_boottime_ns;
+    int64_t frame_start_ns; // CLOCK_MONOTONIC at the start of the current frame
+    size_t resumes;
+} Frame_Clock;
+
+static Frame_Clock frame_clock = {0};
+
+clockid_t suspend_policy_clock(Suspend_Policy policy) {
+    return policy == SUSPEND_PAUSE ? CLOCK_MONOTONIC : CLOCK_BOOTTIME;
+}
+
+// Parses `real`, `fixed:DT`, `replay:FILE` or `record:FILE`
+Clock_Config parse_clock_config(const char *text) {
+    Clock_Config config = {0};
+    if (strcmp(text, "real") == 0) {
+        config.source = CLOCK_SOURCE_REAL;
+    } else if (strncmp(text, "fixed:", 6) == 0) {
+        config.source = CLOCK_SOURCE_FIXED;
+        char *endptr = NULL;
+        config.fixed_step = strtod(text + 6, &endptr);
+        config.fixed_dt = (float) config.fixed_step;
+        if (endptr == text + 6 || *endptr != '\0' || config.fixed_dt <= 0.0f) {
+            fprintf(stderr, "`%s` is not a positive step in seconds\n", text + 6);
+            exit(1);
+        }
+    } else if (strncmp(text, "replay:", 7) == 0) {
+        config.source = CLOCK_SOURCE_REPLAY;
+        config.path = text + 7;
+    } else if (strncmp(text, "record:", 7) == 0) {
+        config.source = CLOCK_SOURCE_RECORD;
+        config.path = text + 7;
+    } else {
+        fprintf(stderr, "`%s` is an unknown clock source, expected real, fixed:DT, replay:FILE or record:FILE\n", text);
+        exit(1);
+    }
+    return config;
+}
+
+bool frame_clock_init(Suspend_Policy policy, Clock_Config config) {
+    frame_clock.policy = policy;
+    frame_clock.config = config;
+    frame_clock.exhausted = 0;
+    if (config.source == CLOCK_SOURCE_REPLAY || config.source == CLOCK_SOURCE_RECORD) {
+        frame_clock.file = fopen(config.path, config.source == CLOCK_SOURCE_REPLAY ? "r" : "w");
+        if (!frame_clock.file) {
+            fprintf(stderr, "ERROR: could not open clock file `%s`: %s\n", config.path, strerror(errno));
+            return false;
+        }
+    }
+    frame_clock.last_monotonic_ns = clock_ns(CLOCK_MONOTONIC);
+    frame_clock.last_boottime_ns = clock_ns(CLOCK_BOOTTIME);
+    frame_clock.frame_start_ns = frame_clock.last_monotonic_ns;
+    return true;
+}
+
+void frame_clock_end(void) {
+    if (frame_clock.file) fclose(frame_clock.file);
+    frame_clock.file = NULL;
+}
+
+// Step of the next tick for the virtual sources (fixed step and replay), in
+// double precision as written, for references that must not share the float rounding
+double frame_clock_virtual_step(void) {
+    if (frame_clock.config.source == CLOCK_SOURCE_FIXED) return frame_clock.config.fixed_step;
+
+    double step;
+    if (frame_clock.exhausted || !frame_clock.file || fscanf(frame_clock.file, "%lf", &step) != 1) {
+        frame_clock.exhausted = 1;
+        return 0.0;
+    }
+    return step;
+}
+
+// dt of the next tick for the virtual sources
+float frame_clock_virtual_dt(void) {
+    return (float) frame_clock_virtual_step();
+}
+
+// Returns the awake time since the previous tick in seconds. Time the machine
+// spent suspended goes to *suspended, and only when the policy counts it.
+float frame_clock_tick(float *suspended) {
+    *suspended = 0.0f;
+    int64_t monotonic_ns = clock_ns(CLOCK_MONOTONIC);
+    frame_clock.frame_start_ns = monotonic_ns;
+    if (frame_clock.config.source == CLOCK_SOURCE_FIXED || frame_clock.config.source == CLOCK_SOURCE_REPLAY) {
+        return frame_clock_virtual_dt();
+    }
+
+    int64_t boottime_ns = clock_ns(CLOCK_BOOTTIME);
+    int64_t awake_ns = monotonic_ns - frame_clock.last_monotonic_ns;
+    int64_t slept_ns = (boottime_ns - frame_clock.last_boottime_ns) - awake_ns;
+    frame_clock.last_monotonic_ns = monotonic_ns;
+    frame_clock.last_boottime_ns = boottime_ns;
+
+    if (slept_ns > SUSPEND_DETECT_THRESHOLD_NS) {
+        frame_clock.resumes++;
+        fprintf(stderr, "INFO: resumed after %.1fs of suspend (%s)\n", slept_ns / 1e9,
+                frame_clock.policy == SUSPEND_PAUSE ? "not counted" : "counted");
+        if (frame_clock.policy == SUSPEND_COUNT) *suspended = (float) ((double) slept_ns / 1e9);
+    } else if (frame_clock.policy == SUSPEND_COUNT && slept_ns > 0) {
+        awake_ns += slept_ns;
+    }
+
+    float dt = (float) ((double) awake_ns / 1e9);
+    if (frame_clock.file) fprintf(frame_clock.file, "%.9g\n", dt + *suspended);
+    return dt;
+}
@@ -0,0 +1,76 @@
+// Frame-start interval statistics. Recording is a handful of integer ops per
+// frame so it is always on; the report is printed by `--bench-frames` and the
+// numbers are available to anything else that wants to export them.
+
+#define FRAME_STATS_BUCKET_US 250
+#define FRAME_STATS_BUCKETS 400 // 0..100ms, anything slower lands in the last bucket
+#define FRAME_STATS_BAR_WIDTH 50
+
+typedef struct {
+    int64_t last_start_ns;
+    int64_t budget_ns;
+    uint64_t frames;
+    uint64_t missed_deadlines; // frames that started more than half a frame late
+    int64_t worst_interval_ns;
+    int64_t total_interval_ns;
+    uint64_t buckets[FRAME_STATS_BUCKETS];
+} Frame_Stats;
+
+static Frame_Stats frame_stats = {0};
+
+void frame_stats_begin_frame(int64_t start_ns, int64_t budget_ns) {
+    frame_stats.budget_ns = budget_ns;
+    if (frame_stats.last_start_ns != 0) {
+        int64_t interval_ns = start_ns - frame_stats.last_start_ns;
+        size_t bucket = (size_t) (interval_ns / (FRAME_STATS_BUCKET_US * 1000));
+        if (bucket >= FRAME_STATS_BUCKETS) bucket = FRAME_STATS_BUCKETS - 1;
+        frame_stats.buckets[bucket]++;
+        frame_stats.frames++;
+        frame_stats.total_interval_ns += interval_ns;
+        if (interval_ns > frame_stats.worst_interval_ns) frame_stats.worst_interval_ns = interval_ns;
+        if (interval_ns > budget_ns + budget_ns / 2) frame_stats.missed_deadlines++;
+    }
+    frame_stats.last_start_ns = start_ns;
+}
+
+// Upper edge of the bucket that holds the given quantile, in milliseconds
+double frame_stats_quantile_ms(double q) {
+    uint64_t target = (uint64_t) ceil(q * (double) frame_stats.frames);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < FRAME_STATS_BUCKETS; ++i) {
+        seen += frame_stats.buckets[i];
+        if (seen >= target && seen > 0) return (double) ((i + 1) * FRAME_STATS_BUCKET_US) / 1000.0;
+    }
+    return (double) (FRAME_STATS_BUCKETS * FRAME_STATS_BUCKET_US) / 1000.0;
+}
+
+void frame_stats_report(FILE *out) {
+    if (frame_stats.frames == 0) {
+        fprintf(out, "no frames recorded\n");
+        return;
+    }
+
+    const double budget_ms = frame_stats.budget_ns / 1e6;
+    fprintf(out, "frames             %llu\n", (unsigned long long) frame_stats.frames);
+    fprintf(out, "frame budget       %.3fms\n", budget_ms);
+    fprintf(out, "mean interval      %.3fms\n", frame_stats.total_interval_ns / 1e6 / frame_stats.frames);
+    fprintf(out, "p50 / p99 / p99.9  %.2fms / %.2fms / %.2fms\n",
+            frame_stats_quantile_ms(0.5), frame_stats_quantile_ms(0.99), frame_stats_quantile_ms(0.999));
+    fprintf(out, "worst interval     %.3fms (%.3fms late)\n", frame_stats.worst_interval_ns / 1e6,
+            fmax(frame_stats.worst_interval_ns / 1e6 - budget_ms, 0.0));
+    fprintf(out, "missed deadlines   %llu (%.2f%%)\n", (unsigned long long) frame_stats.missed_deadlines,
+            100.0 * frame_stats.missed_deadlines / frame_stats.frames);
+
+    uint64_t peak = 0;
+    for (size_t i = 0; i < FRAME_STATS_BUCKETS; ++i) {
+        if (frame_stats.buckets[i] > peak) peak = frame_stats.buckets[i];
+    }
+    fprintf(out, "frame-start interval histogram:\n");
+    for (size_t i = 0; i < FRAME_STATS_BUCKETS; ++i) {
+        if (frame_stats.buckets[i] == 0) continue;
+        int bar = (int) ((frame_stats.buckets[i] * FRAME_STATS_BAR_WIDTH + peak - 1) / peak);
+        fprintf(out, "  %6.2fms%s %8llu %.*s\n", (double) (i * FRAME_STATS_BUCKET_US) / 1000.0,
+                i == FRAME_STATS_BUCKETS - 1 ? "+" : " ", (unsigned long long) frame_stats.buckets[i],
+                bar, "##################################################");
+    }
+}
@@ -0,0 +1,82 @@
+// Shadow copy of the GL state the frame loop keeps setting: the program, the
+// active texture unit and the uniforms of the current program. A call whose
+// value matches the shadow never reaches the driver, which matters most on
+// software GL where every glUniform* walks the whole state validation path.
+// Issued and elided calls are counted for the --bench-frames report.
+
+#define GL_CACHE_UNIFORMS_CAP 32
+
+typedef struct {
+    bool valid;
+    uint32_t bits[4]; // raw value, so floats compare exactly and ints fit too
+} Gl_Cache_Uniform;
+
+typedef struct {
+    GLuint program;
+    GLenum active_texture;
+    Gl_Cache_Uniform uniforms[GL_CACHE_UNIFORMS_CAP];
+    uint64_t issued;
+    uint64_t elided;
+} Gl_Cache;
+
+static Gl_Cache gl_cache = {0};
+
+// Returns true when the uniform has to be sent, and remembers the new value
+static bool gl_cache_uniform_changed(GLint location, const void *value, size_t size) {
+    if (location < 0 || location >= GL_CACHE_UNIFORMS_CAP) {
+        gl_cache.issued++;
+        return true;
+    }
+    Gl_Cache_Uniform *uniform = &gl_cache.uniforms[location];
+    if (uniform->valid && memcmp(uniform->bits, value, size) == 0) {
+        gl_cache.elided++;
+        return false;
+    }
+    uniform->valid = true;
+    memcpy(uniform->bits, value, size);
+    gl_cache.issued++;
+    return true;
+}
+
+void gl_cache_use_program(GLuint program) {
+    if (gl_cache.program == program) {
+        gl_cache.elided++;
+        return;
+    }
+    // uniform values belong to the program
+    memset(gl_cache.uniforms, 0, sizeof(gl_cache.uniforms));
+    gl_cache.program = program;
+    gl_cache.issued++;
+    glUseProgram(program);
+}
+
+void gl_cache_active_texture(GLenum texture) {
+    if (gl_cache.active_texture == texture) {
+        gl_cache.elided++;
+        return;
+    }
+    gl_cache.active_texture = texture;
+    gl_cache.issued++;
+    glActiveTexture(texture);
+}
+
+void gl_cache_uniform1i(GLint location, GLint v0) {
+    GLint value[1] = {v0};
+    if (gl_cache_uniform_changed(location, value, sizeof(value))) glUniform1i(location, v0);
+}
+
+void gl_cache_uniform2f(GLint location, GLfloat v0, GLfloat v1) {
+    GLfloat value[2] = {v0, v1};
+    if (gl_cache_uniform_changed(location, value, sizeof(value))) glUniform2f(location, v0, v1);
+}
+
+void gl_cache_uniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) {
+    GLfloat value[4] = {v0, v1, v2, v3};
+    if (gl_cache_uniform_changed(location, value, sizeof(value))) glUniform4f(location, v0, v1, v2, v3);
+}
+
+void gl_cache_report(FILE *out) {
+    uint64_t total = gl_cache.issued + gl_cache.elided;
+    fprintf(out, "GL state calls: %llu issued, %llu elided (%.1f%%)\n", (unsigned long long) gl_cache.issued,
+            (unsigned long long) gl_cache.elided, total ? 100.0 * gl_cache.elided / total : 0.0);
+}
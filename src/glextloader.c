@@ -1,44 +1,194 @@
+// GL entry points that libGL does not export are loaded through PROCS. A proc
+// is listed with its pointer type, return type, parameters and argument names,
+// the last three are only needed to generate the wrappers of the GL_TRACE build.
 #define PROCS \
-    PROC(PFNGLCREATESHADERPROC, glCreateShader) \
-    PROC(PFNGLSHADERSOURCEPROC, glShaderSource) \
-    PROC(PFNGLCOMPILESHADERPROC, glCompileShader) \
-    PROC(PFNGLGETSHADERIVPROC, glGetShaderiv) \
-    PROC(PFNGLGETSHADERINFOLOGPROC, glGetShaderInfoLog) \
-    PROC(PFNGLCREATEPROGRAMPROC, glCreateProgram) \
-    PROC(PFNGLATTACHSHADERPROC, glAttachShader) \
-    PROC(PFNGLLINKPROGRAMPROC, glLinkProgram) \
-    PROC(PFNGLGETPROGRAMIVPROC, glGetProgramiv) \
-    PROC(PFNGLGETPROGRAMINFOLOGPROC, glGetProgramInfoLog) \
-    PROC(PFNGLDELETESHADERPROC, glDeleteShader) \
-    PROC(PFNGLUSEPROGRAMPROC, glUseProgram) \
-    PROC(PFNGLGENVERTEXARRAYSPROC, glGenVertexArrays) \
-    PROC(PFNGLBINDVERTEXARRAYPROC, glBindVertexArray) \
-    PROC(PFNGLDELETEPROGRAMPROC, glDeleteProgram) \
-    PROC(PFNGLGETUNIFORMLOCATIONPROC, glGetUniformLocation) \
-    PROC(PFNGLUNIFORM2FPROC, glUniform2f) \
-    PROC(PFNGLGENBUFFERSPROC, glGenBuffers) \
-    PROC(PFNGLBINDBUFFERPROC, glBindBuffer) \
-    PROC(PFNGLBUFFERDATAPROC, glBufferData) \
-    PROC(PFNGLENABLEVERTEXATTRIBARRAYPROC, glEnableVertexAttribArray) \
-    PROC(PFNGLVERTEXATTRIBPOINTERPROC, glVertexAttribPointer) \
-    PROC(PFNGLUNIFORM1FPROC, glUniform1f) \
-    PROC(PFNGLBUFFERSUBDATAPROC, glBufferSubData) \
-    PROC(PFNGLGENFRAMEBUFFERSPROC, glGenFramebuffers) \
-    PROC(PFNGLBINDFRAMEBUFFERPROC, glBindFramebuffer) \
-    PROC(PFNGLFRAMEBUFFERTEXTURE2DPROC, glFramebufferTexture2D) \
-    PROC(PFNGLCHECKFRAMEBUFFERSTATUSPROC, glCheckFramebufferStatus) \
-    PROC(PFNGLUNIFORM1IPROC, glUniform1i) \
-    PROC(PFNGLDRAWBUFFERSPROC, glDrawBuffers) \
-    PROC(PFNGLUNIFORM4FPROC, glUniform4f) \
-    PROC(PFNGLUNIFORM1UIPROC, glUniform1ui)
-
-#define PROC(type, name) static type name = NULL;
+    PROC(PFNGLCREATESHADERPROC, glCreateShader, GLuint, (GLenum type), (type)) \
+    PROC(PFNGLSHADERSOURCEPROC, glShaderSource, void, (GLuint shader, GLsizei count, const GLchar *const*string, const GLint *length), (shader, count, string, length)) \
+    PROC(PFNGLCOMPILESHADERPROC, glCompileShader, void, (GLuint shader), (shader)) \
+    PROC(PFNGLGETSHADERIVPROC, glGetShaderiv, void, (GLuint shader, GLenum pname, GLint *params), (shader, pname, params)) \
+    PROC(PFNGLGETSHADERINFOLOGPROC, glGetShaderInfoLog, void, (GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *infoLog), (shader, bufSize, length, infoLog)) \
+    PROC(PFNGLCREATEPROGRAMPROC, glCreateProgram, GLuint, (void), ()) \
+    PROC(PFNGLATTACHSHADERPROC, glAttachShader, void, (GLuint program, GLuint shader), (program, shader)) \
+    PROC(PFNGLLINKPROGRAMPROC, glLinkProgram, void, (GLuint program), (program)) \
+    PROC(PFNGLGETPROGRAMIVPROC, glGetProgramiv, void, (GLuint program, GLenum pname, GLint *params), (program, pname, params)) \
+    PROC(PFNGLGETPROGRAMINFOLOGPROC, glGetProgramInfoLog, void, (GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog), (program, bufSize, length, infoLog)) \
+    PROC(PFNGLDELETESHADERPROC, glDeleteShader, void, (GLuint shader), (shader)) \
+    PROC(PFNGLUSEPROGRAMPROC, glUseProgram, void, (GLuint program), (program)) \
+    PROC(PFNGLGENVERTEXARRAYSPROC, glGenVertexArrays, void, (GLsizei n, GLuint *arrays), (n, arrays)) \
+    PROC(PFNGLBINDVERTEXARRAYPROC, glBindVertexArray, void, (GLuint array), (array)) \
+    PROC(PFNGLDELETEPROGRAMPROC, glDeleteProgram, void, (GLuint program), (program)) \
+    PROC(PFNGLGETUNIFORMLOCATIONPROC, glGetUniformLocation, GLint, (GLuint program, const GLchar *name), (program, name)) \
+    PROC(PFNGLUNIFORM2FPROC, glUniform2f, void, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1)) \
+    PROC(PFNGLGENBUFFERSPROC, glGenBuffers, void, (GLsizei n, GLuint *buffers), (n, buffers)) \
+    PROC(PFNGLBINDBUFFERPROC, glBindBuffer, void, (GLenum target, GLuint buffer), (target, buffer)) \
+    PROC(PFNGLBUFFERDATAPROC, glBufferData, void, (GLenum target, GLsizeiptr size, const void *data, GLenum usage), (target, size, data, usage)) \
+    PROC(PFNGLENABLEVERTEXATTRIBARRAYPROC, glEnableVertexAttribArray, void, (GLuint index), (index)) \
+    PROC(PFNGLVERTEXATTRIBPOINTERPROC, glVertexAttribPointer, void, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer), (index, size, type, normalized, stride, pointer)) \
+    PROC(PFNGLUNIFORM1FPROC, glUniform1f, void, (GLint location, GLfloat v0), (location, v0)) \
+    PROC(PFNGLBUFFERSUBDATAPROC, glBufferSubData, void, (GLenum target, GLintptr offset, GLsizeiptr size, const void *data), (target, offset, size, data)) \
+    PROC(PFNGLGENFRAMEBUFFERSPROC, glGenFramebuffers, void, (GLsizei n, GLuint *framebuffers), (n, framebuffers)) \
+    PROC(PFNGLBINDFRAMEBUFFERPROC, glBindFramebuffer, void, (GLenum target, GLuint framebuffer), (target, framebuffer)) \
+    PROC(PFNGLFRAMEBUFFERTEXTURE2DPROC, glFramebufferTexture2D, void, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level), (target, attachment, textarget, texture, level)) \
+    PROC(PFNGLCHECKFRAMEBUFFERSTATUSPROC, glCheckFramebufferStatus, GLenum, (GLenum target), (target)) \
+    PROC(PFNGLUNIFORM1IPROC, glUniform1i, void, (GLint location, GLint v0), (location, v0)) \
+    PROC(PFNGLDRAWBUFFERSPROC, glDrawBuffers, void, (GLsizei n, const GLenum *bufs), (n, bufs)) \
+    PROC(PFNGLUNIFORM4FPROC, glUniform4f, void, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3), (location, v0, v1, v2, v3)) \
+    PROC(PFNGLUNIFORM1UIPROC, glUniform1ui, void, (GLint location, GLuint v0), (location, v0)) \
+    PROC(PFNGLFENCESYNCPROC, glFenceSync, GLsync, (GLenum condition, GLbitfield flags), (condition, flags)) \
+    PROC(PFNGLCLIENTWAITSYNCPROC, glClientWaitSync, GLenum, (GLsync sync, GLbitfield flags, GLuint64 timeout), (sync, flags, timeout)) \
+    PROC(PFNGLDELETESYNCPROC, glDeleteSync, void, (GLsync sync), (sync)) \
+    PROC(PFNGLDELETEBUFFERSPROC, glDeleteBuffers, void, (GLsizei n, const GLuint *buffers), (n, buffers)) \
+    PROC(PFNGLTEXSTORAGE2DPROC, glTexStorage2D, void, (GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height), (target, levels, internalformat, width, height)) \
+    PROC(PFNGLDELETEFRAMEBUFFERSPROC, glDeleteFramebuffers, void, (GLsizei n, const GLuint *framebuffers), (n, framebuffers)) \
+    PROC(PFNGLGENRENDERBUFFERSPROC, glGenRenderbuffers, void, (GLsizei n, GLuint *renderbuffers), (n, renderbuffers)) \
+    PROC(PFNGLBINDRENDERBUFFERPROC, glBindRenderbuffer, void, (GLenum target, GLuint renderbuffer), (target, renderbuffer)) \
+    PROC(PFNGLRENDERBUFFERSTORAGEPROC, glRenderbufferStorage, void, (GLenum target, GLenum internalformat, GLsizei width, GLsizei height), (target, internalformat, width, height)) \
+    PROC(PFNGLFRAMEBUFFERRENDERBUFFERPROC, glFramebufferRenderbuffer, void, (GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer), (target, attachment, renderbuffertarget, renderbuffer)) \
+    PROC(PFNGLBLITFRAMEBUFFERPROC, glBlitFramebuffer, void, (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter), (srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter)) \
+    PROC(PFNGLMAPBUFFERRANGEPROC, glMapBufferRange, void *, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), (target, offset, length, access)) \
+    PROC(PFNGLUNMAPBUFFERPROC, glUnmapBuffer, GLboolean, (GLenum target), (target)) \
+    PROC(PFNGLGETSTRINGIPROC, glGetStringi, const GLubyte *, (GLenum name, GLuint index), (name, index))
+
+#ifdef GL_TRACE
+// `make GL_TRACE=1`: every proc is called through a wrapper that counts the
+// calls and the CPU time spent inside. The frame loop also calls a few entry
+// points that libGL exports, listed in CORE_PROCS. gl.h declares those, so they
+// keep their names: the trace build loads them like the others and redirects
+// the names to the wrappers with the #defines at the end of this block. The
+// rest of what libGL exports is linked directly and not traced.
+#define CORE_PROCS \
+    CORE_PROC(glDrawArrays, void, (GLenum mode, GLint first, GLsizei count), (mode, first, count)) \
+    CORE_PROC(glClear, void, (GLbitfield mask), (mask)) \
+    CORE_PROC(glTexSubImage2D, void, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels), (target, level, xoffset, yoffset, width, height, format, type, pixels)) \
+    CORE_PROC(glActiveTexture, void, (GLenum texture), (texture)) \
+    CORE_PROC(glViewport, void, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height)) \
+    CORE_PROC(glBindTexture, void, (GLenum target, GLuint texture), (target, texture))
+
+typedef enum {
+    #define PROC(type, name, ret, params, args) GL_TRACE_##name,
+    PROCS
+    #undef PROC
+    #define CORE_PROC(name, ret, params, args) GL_TRACE_##name,
+    CORE_PROCS
+    #undef CORE_PROC
+    COUNT_GL_TRACE_PROCS,
+} Gl_Trace_Proc;
+
+static const char *gl_trace_proc_names[COUNT_GL_TRACE_PROCS] = {
+    #define PROC(type, name, ret, params, args) [GL_TRACE_##name] = #name,
+    PROCS
+    #undef PROC
+    #define CORE_PROC(name, ret, params, args) [GL_TRACE_##name] = #name,
+    CORE_PROCS
+    #undef CORE_PROC
+};
+
+typedef struct {
+    uint64_t calls[COUNT_GL_TRACE_PROCS];
+    int64_t ns[COUNT_GL_TRACE_PROCS];
+    uint64_t frames;
+} Gl_Trace;
+
+static Gl_Trace gl_trace = {0};
+
+typedef struct {
+    Gl_Trace_Proc proc;
+    int64_t start_ns;
+} Gl_Trace_Scope;
+
+// Runs when the wrapper returns, after the real call has produced its value
+static void gl_trace_scope_end(Gl_Trace_Scope *scope) {
+    gl_trace.ns[scope->proc] += clock_ns(CLOCK_MONOTONIC) - scope->start_ns;
+    gl_trace.calls[scope->proc]++;
+}
+
+#define PROC(type, name, ret, params, args) \
+    static type name = NULL; \
+    static type name##_real = NULL; \
+    static ret APIENTRY name##_traced params { \
+        Gl_Trace_Scope scope __attribute__((cleanup(gl_trace_scope_end))) = {GL_TRACE_##name, clock_ns(CLOCK_MONOTONIC)}; \
+        return name##_real args; \
+    }
+PROCS
+#undef PROC
+
+#define CORE_PROC(name, ret, params, args) \
+    static __typeof__(&name) name##_real = name; \
+    static ret APIENTRY name##_traced params { \
+        Gl_Trace_Scope scope __attribute__((cleanup(gl_trace_scope_end))) = {GL_TRACE_##name, clock_ns(CLOCK_MONOTONIC)}; \
+        return name##_real args; \
+    }
+CORE_PROCS
+#undef CORE_PROC
+
+static void load_gl_extensions(void)
+{
+    // a missing proc stays NULL so the callers' fallbacks still kick in
+    #define PROC(type, name, ret, params, args) \
+        name##_real = (type) RGFW_getProcAddress(#name); \
+        name = name##_real ? name##_traced : NULL;
+    PROCS
+    #undef PROC
+    // the exported symbol stays as the fallback
+    #define CORE_PROC(name, ret, params, args) { \
+        __typeof__(&name) proc = (__typeof__(&name)) RGFW_getProcAddress(#name); \
+        if (proc) name##_real = proc; \
+    }
+    CORE_PROCS
+    #undef CORE_PROC
+}
+
+void gl_trace_end_frame(void) {
+    gl_trace.frames++;
+}
+
+static int gl_trace_compare_ns(const void *a, const void *b) {
+    int64_t x = gl_trace.ns[*(const Gl_Trace_Proc*) a];
+    int64_t y = gl_trace.ns[*(const Gl_Trace_Proc*) b];
+    return (x < y) - (x > y);
+}
+
+void gl_trace_report(FILE *out) {
+    Gl_Trace_Proc order[COUNT_GL_TRACE_PROCS];
+    for (size_t i = 0; i < COUNT_GL_TRACE_PROCS; ++i) order[i] = (Gl_Trace_Proc) i;
+    qsort(order, COUNT_GL_TRACE_PROCS, sizeof(order[0]), gl_trace_compare_ns);
+
+    const double frames = gl_trace.frames ? (double) gl_trace.frames : 1.0;
+    fprintf(out, "GL calls over %llu frames:\n", (unsigned long long) gl_trace.frames);
+    fprintf(out, "  %-26s %12s %12s %12s %10s\n", "proc", "calls", "calls/frame", "total ms", "ns/call");
+    for (size_t i = 0; i < COUNT_GL_TRACE_PROCS; ++i) {
+        Gl_Trace_Proc proc = order[i];
+        if (gl_trace.calls[proc] == 0) continue;
+        fprintf(out, "  %-26s %12llu %12.2f %12.3f %10.0f\n", gl_trace_proc_names[proc],
+                (unsigned long long) gl_trace.calls[proc], gl_trace.calls[proc] / frames, gl_trace.ns[proc] / 1e6,
+                (double) gl_trace.ns[proc] / gl_trace.calls[proc]);
+    }
+}
+
+#define glDrawArrays glDrawArrays_traced
+#define glClear glClear_traced
+#define glTexSubImage2D glTexSubImage2D_traced
+#define glActiveTexture glActiveTexture_traced
+#define glViewport glViewport_traced
+#define glBindTexture glBindTexture_traced
+
+#else
+
+#define PROC(type, name, ret, params, args) static type name = NULL;
 PROCS
 #undef PROC
 
 static void load_gl_extensions(void)
 {
-    #define PROC(type, name) name = (type) RGFW_getProcAddress(#name);
+    #define PROC(type, name, ret, params, args) name = (type) RGFW_getProcAddress(#name);
     PROCS
     #undef PROC
 }
+
+void gl_trace_end_frame(void) {}
+
+void gl_trace_report(FILE *out) {
+    fprintf(out, "INFO: GL call tracing is not compiled in, rebuild with `make -B GL_TRACE=1`\n");
+}
+
+#endif // GL_TRACE
@@ -0,0 +1,206 @@
+// Adaptive quality (`--governor`). When frames keep starting late the
+// governor sheds effects one step at a time: first the digit wiggle freezes,
+// then the penger is no longer drawn, then the scene is rendered at half
+// resolution and scaled up. The digits are never shed. The displayed time
+// comes from the frame clock, so it stays right on an overloaded box even
+// when the frame rate drops.
+//
+// Two moving averages drive it, with hysteresis between them. Stepping down
+// needs the frame-start interval above GOVERNOR_OVERLOAD budgets. Stepping up
+// needs the busy time (the frame minus the swap, which blocks on vsync)
+// below GOVERNOR_HEADROOM budgets, held for restore_hold_ns. A level that was
+// restored and had to be shed again within that hold doubles the hold, so
+// a box on the edge does not flap between levels. A single interval counts
+// for at most GOVERNOR_SAMPLE_CLAMP budgets, and the frame after a suspend is
+// not sampled at all, so one long stall cannot shed a level on its own.
+
+#define GOVERNOR_EWMA_WEIGHT 0.1
+#define GOVERNOR_OVERLOAD 1.25
+#define GOVERNOR_HEADROOM 0.5
+#define GOVERNOR_SAMPLE_CLAMP 4.0 // budgets
+#define GOVERNOR_SETTLE_NS 1000000000LL        // at a level before stepping further down
+#define GOVERNOR_RESTORE_HOLD_NS 3000000000LL  // initial hold before stepping up
+#define GOVERNOR_RESTORE_HOLD_MAX_NS 60000000000LL
+#define GOVERNOR_LOW_RES_DIVISOR 2
+
+typedef enum {
+    QUALITY_FULL = 0,
+    QUALITY_NO_WIGGLE,
+    QUALITY_NO_PENGER,
+    QUALITY_LOW_RES,
+    COUNT_QUALITY_LEVELS,
+} Quality_Level;
+
+static const char *quality_level_names[COUNT_QUALITY_LEVELS] = {
+    [QUALITY_FULL]      = "full",
+    [QUALITY_NO_WIGGLE] = "no wiggle",
+    [QUALITY_NO_PENGER] = "no penger",
+    [QUALITY_LOW_RES]   = "low resolution",
+};
+
+typedef struct {
+    bool enabled;
+    Quality_Level level;
+    Quality_Level max_level; // lower when the low resolution target cannot be made
+    size_t frozen_wiggle_index;
+
+    int64_t budget_ns;
+    int64_t frame_start_ns;
+    int64_t swap_start_ns;
+    int64_t swap_ns;
+    double interval_avg_ns;
+    double busy_avg_ns;
+
+    int64_t level_since_ns;
+    int64_t restored_at_ns;
+    int64_t restore_hold_ns;
+    int64_t level_ns[COUNT_QUALITY_LEVELS];
+    uint64_t transitions;
+
+    GLuint fbo;
+    GLuint rbo;
+    int target_width;
+    int target_height;
+} Governor;
+
+static Governor governor = {0};
+
+void governor_begin(bool enabled) {
+    if (!enabled) return;
+    governor.enabled = true;
+    governor.max_level = QUALITY_LOW_RES;
+    governor.restore_hold_ns = GOVERNOR_RESTORE_HOLD_NS;
+    governor.level_since_ns = clock_ns(CLOCK_MONOTONIC);
+}
+
+static void governor_set_level(Quality_Level level, size_t wiggle_index, int64_t now_ns) {
+    fprintf(stderr, "INFO: quality %s -> %s (frame interval %.2fms, busy %.2fms, budget %.2fms)\n",
+            quality_level_names[governor.level], quality_level_names[level], governor.interval_avg_ns / 1e6,
+            governor.busy_avg_ns / 1e6, governor.budget_ns / 1e6);
+    if (governor.level < QUALITY_NO_WIGGLE && level >= QUALITY_NO_WIGGLE) governor.frozen_wiggle_index = wiggle_index;
+    governor.level_ns[governor.level] += now_ns - governor.level_since_ns;
+    governor.level = level;
+    governor.level_since_ns = now_ns;
+    governor.transitions++;
+}
+
+// suspended: frame_clock_tick reported a suspend before this frame
+void governor_frame_begin(int64_t start_ns, int64_t budget_ns, bool suspended) {
+    if (!governor.enabled) return;
+    if (budget_ns != governor.budget_ns) {
+        // the power policy changed the frame rate, the old averages mean nothing now
+        governor.budget_ns = budget_ns;
+        governor.interval_avg_ns = (double) budget_ns;
+        governor.busy_avg_ns = 0.0;
+    } else if (governor.frame_start_ns != 0 && !suspended) {
+        double interval_ns = (double) (start_ns - governor.frame_start_ns);
+        if (interval_ns > GOVERNOR_SAMPLE_CLAMP * budget_ns) interval_ns = GOVERNOR_SAMPLE_CLAMP * budget_ns;
+        governor.interval_avg_ns += GOVERNOR_EWMA_WEIGHT * (interval_ns - governor.interval_avg_ns);
+    }
+    governor.frame_start_ns = start_ns;
+    governor.swap_ns = 0;
+}
+
+void governor_swap_begin(void) {
+    if (governor.enabled) governor.swap_start_ns = clock_ns(CLOCK_MONOTONIC);
+}
+
+void governor_swap_end(void) {
+    if (governor.enabled) governor.swap_ns += clock_ns(CLOCK_MONOTONIC) - governor.swap_start_ns;
+}
+
+// Call once the frame's work is done, right before the loop goes to sleep
+void governor_frame_end(size_t wiggle_index) {
+    if (!governor.enabled) return;
+    int64_t now_ns = clock_ns(CLOCK_MONOTONIC);
+    double busy_ns = (double) (now_ns - governor.frame_start_ns - governor.swap_ns);
+    governor.busy_avg_ns += GOVERNOR_EWMA_WEIGHT * (busy_ns - governor.busy_avg_ns);
+
+    const double budget_ns = (double) governor.budget_ns;
+    const int64_t at_level_ns = now_ns - governor.level_since_ns;
+    if (governor.interval_avg_ns > GOVERNOR_OVERLOAD * budget_ns && governor.level < governor.max_level &&
+        at_level_ns >= GOVERNOR_SETTLE_NS) {
+        if (governor.restored_at_ns != 0 && now_ns - governor.restored_at_ns < governor.restore_hold_ns) {
+            governor.restore_hold_ns *= 2;
+            if (governor.restore_hold_ns > GOVERNOR_RESTORE_HOLD_MAX_NS) governor.restore_hold_ns = GOVERNOR_RESTORE_HOLD_MAX_NS;
+        }
+        governor_set_level(governor.level + 1, wiggle_index, now_ns);
+    } else if (governor.busy_avg_ns < GOVERNOR_HEADROOM * budget_ns && governor.level > QUALITY_FULL &&
+               at_level_ns >= governor.restore_hold_ns) {
+        governor_set_level(governor.level - 1, wiggle_index, now_ns);
+        governor.restored_at_ns = now_ns;
+    }
+}
+
+size_t governor_wiggle_index(size_t wiggle_index) {
+    return governor.level >= QUALITY_NO_WIGGLE ? governor.frozen_wiggle_index : wiggle_index;
+}
+
+bool governor_draw_penger(void) {
+    return governor.level < QUALITY_NO_PENGER;
+}
+
+static bool governor_resize_target(int width, int height) {
+    if (governor.fbo == 0) {
+        glGenFramebuffers(1, &governor.fbo);
+        glGenRenderbuffers(1, &governor.rbo);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, governor.rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, governor.fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, governor.rbo);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "WARNING: could not create the low resolution target, quality stops at %s\n",
+                quality_level_names[QUALITY_LOW_RES - 1]);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        governor.max_level = QUALITY_LOW_RES - 1;
+        return false;
+    }
+    governor.target_width = width;
+    governor.target_height = height;
+    return true;
+}
+
+// Redirects the frame into the reduced target when the level asks for it.
+// Drawing code stays in window coordinates, the viewport does the scaling.
+void governor_render_begin(int window_width, int window_height) {
+    if (governor.level < QUALITY_LOW_RES) return;
+    int width = window_width / GOVERNOR_LOW_RES_DIVISOR;
+    int height = window_height / GOVERNOR_LOW_RES_DIVISOR;
+    if (width < 1) width = 1;
+    if (height < 1) height = 1;
+    if (width != governor.target_width || height != governor.target_height) {
+        if (!governor_resize_target(width, height)) {
+            governor_set_level(governor.max_level, 0, clock_ns(CLOCK_MONOTONIC));
+            return;
+        }
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, governor.fbo);
+    }
+    glViewport(0, 0, width, height);
+}
+
+// Scales the reduced target up into the window
+void governor_render_end(int window_width, int window_height) {
+    if (governor.level < QUALITY_LOW_RES) return;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, governor.fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, governor.target_width, governor.target_height, 0, 0, window_width, window_height,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, window_width, window_height);
+}
+
+void governor_report(FILE *out) {
+    if (!governor.enabled) return;
+    governor.level_ns[governor.level] += clock_ns(CLOCK_MONOTONIC) - governor.level_since_ns;
+    governor.level_since_ns = clock_ns(CLOCK_MONOTONIC);
+    int64_t total_ns = 0;
+    for (size_t i = 0; i < COUNT_QUALITY_LEVELS; ++i) total_ns += governor.level_ns[i];
+    fprintf(out, "quality governor: %llu transitions, ended at %s\n", (unsigned long long) governor.transitions,
+            quality_level_names[governor.level]);
+    for (size_t i = 0; i < COUNT_QUALITY_LEVELS; ++i) {
+        fprintf(out, "  %-16s %.1fs (%.1f%%)\n", quality_level_names[i], governor.level_ns[i] / 1e9,
+                total_ns ? 100.0 * governor.level_ns[i] / total_ns : 0.0);
+    }
+}
@@ -0,0 +1,55 @@
+// Render-ahead limit (`--gpu-queue N`, 1 to 3). A fence goes in after every
+// swap, and before the next frame issues any GL work the loop waits for the
+// fence from N frames back. So at most N frames are queued in the driver, and
+// a visual change like the pause color shows up at most N frames late,
+// however far ahead the driver would like to run on its own.
+
+#define GPU_QUEUE_TIMEOUT_NS 1000000000ULL
+
+typedef struct {
+    int depth; // 0 when not limited
+    GLsync fences[GPU_QUEUE_MAX];
+    size_t head;
+    size_t count;
+    uint64_t waits;      // fences that were not signalled yet when waited on
+    int64_t waited_ns;
+} Gpu_Queue;
+
+static Gpu_Queue gpu_queue = {0};
+
+void gpu_queue_begin(int depth) {
+    if (depth == 0) return;
+    if (!glFenceSync || !glClientWaitSync || !glDeleteSync) {
+        fprintf(stderr, "WARNING: no fence sync support, --gpu-queue ignored\n");
+        return;
+    }
+    gpu_queue.depth = depth;
+}
+
+// Call before the first GL command of a frame
+void gpu_queue_wait(void) {
+    if (gpu_queue.depth == 0 || gpu_queue.count < (size_t) gpu_queue.depth) return;
+    GLsync oldest = gpu_queue.fences[gpu_queue.head];
+    if (glClientWaitSync(oldest, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        int64_t start_ns = clock_ns(CLOCK_MONOTONIC);
+        glClientWaitSync(oldest, GL_SYNC_FLUSH_COMMANDS_BIT, GPU_QUEUE_TIMEOUT_NS);
+        gpu_queue.waited_ns += clock_ns(CLOCK_MONOTONIC) - start_ns;
+        gpu_queue.waits++;
+    }
+    glDeleteSync(oldest);
+    gpu_queue.head = (gpu_queue.head + 1) % GPU_QUEUE_MAX;
+    gpu_queue.count--;
+}
+
+// Call right after the swap
+void gpu_queue_push(void) {
+    if (gpu_queue.depth == 0) return;
+    gpu_queue.fences[(gpu_queue.head + gpu_queue.count) % GPU_QUEUE_MAX] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    gpu_queue.count++;
+}
+
+void gpu_queue_report(FILE *out) {
+    if (gpu_queue.depth == 0) return;
+    fprintf(out, "GPU queue depth %d: waited on %llu fences for %.3fms in total\n", gpu_queue.depth,
+            (unsigned long long) gpu_queue.waits, gpu_queue.waited_ns / 1e6);
+}
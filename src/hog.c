@@ -0,0 +1,53 @@
+// Synthetic contention for `--bench-frames`: busy-looping CPU hogs and
+// memory hogs that keep streaming over a buffer much larger than the caches,
+// standing in for the video decoders and browsers our kiosks share CPUs with.
+
+#define HOG_THREADS_CAP 64
+#define HOG_MEMORY_BYTES (64 * 1024 * 1024)
+#define HOG_CACHE_LINE 64
+
+typedef struct {
+    pthread_t threads[HOG_THREADS_CAP];
+    size_t count;
+    atomic_int quit;
+} Hogs;
+
+static Hogs hogs = {0};
+
+static void *hog_cpu(void *arg) {
+    (void) arg;
+    volatile uint64_t x = 1;
+    while (!atomic_load_explicit(&hogs.quit, memory_order_relaxed)) {
+        for (int i = 0; i < 100000; ++i) x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    return NULL;
+}
+
+static void *hog_memory(void *arg) {
+    (void) arg;
+    volatile unsigned char *buffer = malloc(HOG_MEMORY_BYTES);
+    if (!buffer) return NULL;
+    while (!atomic_load_explicit(&hogs.quit, memory_order_relaxed)) {
+        for (size_t i = 0; i < HOG_MEMORY_BYTES; i += HOG_CACHE_LINE) buffer[i]++;
+    }
+    free((void *) buffer);
+    return NULL;
+}
+
+void hogs_start(int cpu_hogs, int memory_hogs) {
+    atomic_store(&hogs.quit, 0);
+    for (int i = 0; i < cpu_hogs + memory_hogs && hogs.count < HOG_THREADS_CAP; ++i) {
+        int err = pthread_create(&hogs.threads[hogs.count], NULL, i < cpu_hogs ? hog_cpu : hog_memory, NULL);
+        if (err != 0) {
+            fprintf(stderr, "WARNING: could not start hog thread: %s\n", strerror(err));
+            break;
+        }
+        hogs.count++;
+    }
+}
+
+void hogs_stop(void) {
+    atomic_store(&hogs.quit, 1);
+    for (size_t i = 0; i < hogs.count; ++i) pthread_join(hogs.threads[i], NULL);
+    hogs.count = 0;
+}
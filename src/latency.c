@@ -0,0 +1,84 @@
+// Input-to-photon latency measurement (`--latency`). Every key press is
+// timestamped as the event loop drains it; after the swap of the frame that
+// first reflects it, the loop waits on a fence for the GPU to finish that
+// frame and records the difference. The wait serializes CPU and GPU, which is
+// why this is a measurement mode and not always on. Without fence support it
+// falls back to glFinish. The histogram is printed at exit.
+
+#define LATENCY_BUCKET_US 250
+#define LATENCY_BUCKETS 400 // 0..100ms, slower presses land in the last bucket
+#define LATENCY_PENDING_CAP 16
+#define LATENCY_FENCE_TIMEOUT_NS 1000000000ULL
+
+typedef struct {
+    int active;
+    int64_t pending[LATENCY_PENDING_CAP]; // drain times of presses not yet on screen
+    size_t pending_count;
+    uint64_t samples;
+    int64_t worst_ns;
+    int64_t total_ns;
+    uint64_t buckets[LATENCY_BUCKETS];
+} Latency;
+
+static Latency latency = {0};
+
+void latency_begin(bool active) {
+    latency.active = active;
+}
+
+void latency_key_drained(void) {
+    if (!latency.active || latency.pending_count == LATENCY_PENDING_CAP) return;
+    latency.pending[latency.pending_count++] = clock_ns(CLOCK_MONOTONIC);
+}
+
+// Call right after the swap
+void latency_frame_presented(void) {
+    if (!latency.active || latency.pending_count == 0) return;
+
+    if (glFenceSync && glClientWaitSync) {
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, LATENCY_FENCE_TIMEOUT_NS);
+        glDeleteSync(fence);
+    } else {
+        glFinish();
+    }
+    int64_t presented_ns = clock_ns(CLOCK_MONOTONIC);
+
+    for (size_t i = 0; i < latency.pending_count; ++i) {
+        int64_t latency_ns = presented_ns - latency.pending[i];
+        size_t bucket = (size_t) (latency_ns / (LATENCY_BUCKET_US * 1000));
+        if (bucket >= LATENCY_BUCKETS) bucket = LATENCY_BUCKETS - 1;
+        latency.buckets[bucket]++;
+        latency.samples++;
+        latency.total_ns += latency_ns;
+        if (latency_ns > latency.worst_ns) latency.worst_ns = latency_ns;
+    }
+    latency.pending_count = 0;
+}
+
+// Upper edge of the bucket that holds the given quantile, in milliseconds
+double latency_quantile_ms(double q) {
+    uint64_t target = (uint64_t) ceil(q * (double) latency.samples);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        seen += latency.buckets[i];
+        if (seen >= target && seen > 0) return (double) ((i + 1) * LATENCY_BUCKET_US) / 1000.0;
+    }
+    return (double) (LATENCY_BUCKETS * LATENCY_BUCKET_US) / 1000.0;
+}
+
+void latency_report(FILE *out) {
+    if (!latency.active) return;
+    if (latency.samples == 0) {
+        fprintf(out, "input-to-photon: no key presses recorded\n");
+        return;
+    }
+    fprintf(out, "input-to-photon over %llu key presses: mean %.2fms, p50 %.2fms, p99 %.2fms, worst %.2fms\n",
+            (unsigned long long) latency.samples, latency.total_ns / 1e6 / latency.samples,
+            latency_quantile_ms(0.5), latency_quantile_ms(0.99), latency.worst_ns / 1e6);
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        if (latency.buckets[i] == 0) continue;
+        fprintf(out, "  %6.2fms%s %8llu\n", (double) (i * LATENCY_BUCKET_US) / 1000.0,
+                i == LATENCY_BUCKETS - 1 ? "+" : " ", (unsigned long long) latency.buckets[i]);
+    }
+}
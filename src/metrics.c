@@ -0,0 +1,188 @@
+// Prometheus textfile exporter (`--metrics FILE`, every `--metrics-interval`,
+// 15s by default) for node_exporter's textfile collector. A writer thread
+// does all the formatting and file I/O. The render thread only copies a
+// snapshot when the writer asks for one, so most frames cost one atomic load.
+// The file is written as FILE.tmp and renamed over FILE, so the collector never
+// scrapes half a file. If the render thread stalls, the writer keeps
+// publishing the last snapshot, and timer_last_frame_timestamp_seconds stops
+// moving, which is what the stall alert watches.
+
+#define METRICS_DEFAULT_INTERVAL 15.0f
+#define METRICS_SNAPSHOT_TIMEOUT_NS 2000000000LL
+
+// Upper bounds of the exported frame interval histogram, in seconds, each a
+// multiple of FRAME_STATS_BUCKET_US
+static const double metrics_frame_buckets[] = {0.004, 0.008, 0.0125, 0.017, 0.025, 0.0335, 0.05, 0.1};
+#define METRICS_FRAME_BUCKETS_COUNT (sizeof(metrics_frame_buckets) / sizeof(metrics_frame_buckets[0]))
+
+typedef struct {
+    bool valid;
+    uint64_t frames;
+    uint64_t missed_deadlines;
+    int64_t total_interval_ns;
+    uint64_t frame_buckets[METRICS_FRAME_BUCKETS_COUNT]; // cumulative, as Prometheus wants them
+    uint64_t x_events;
+    double displayed_time;
+    bool paused;
+    double timestamp; // wall clock seconds when the snapshot was taken
+} Metrics_Snapshot;
+
+typedef struct {
+    bool active;
+    const char *path;
+    int64_t interval_ns;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;   // signals both a taken snapshot and quit
+    atomic_int requested;  // the writer wants a fresh snapshot
+    bool quit;
+    uint64_t x_events;     // render thread only
+    Metrics_Snapshot snapshot;
+} Metrics;
+
+static Metrics metrics = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static struct timespec metrics_deadline(int64_t from_now_ns) {
+    int64_t ns = clock_ns(CLOCK_MONOTONIC) + from_now_ns;
+    return (struct timespec) {.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000};
+}
+
+static void metrics_write(const Metrics_Snapshot *snapshot) {
+    char temp_path[PATH_MAX];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", metrics.path);
+    FILE *out = fopen(temp_path, "w");
+    if (!out) {
+        fprintf(stderr, "WARNING: could not write metrics `%s`: %s\n", temp_path, strerror(errno));
+        return;
+    }
+
+    fprintf(out, "# HELP timer_frames_total Frames rendered.\n");
+    fprintf(out, "# TYPE timer_frames_total counter\n");
+    fprintf(out, "timer_frames_total %llu\n", (unsigned long long) snapshot->frames);
+    fprintf(out, "# HELP timer_missed_deadlines_total Frames that started more than half a frame late.\n");
+    fprintf(out, "# TYPE timer_missed_deadlines_total counter\n");
+    fprintf(out, "timer_missed_deadlines_total %llu\n", (unsigned long long) snapshot->missed_deadlines);
+    fprintf(out, "# HELP timer_frame_interval_seconds Time between frame starts.\n");
+    fprintf(out, "# TYPE timer_frame_interval_seconds histogram\n");
+    for (size_t i = 0; i < METRICS_FRAME_BUCKETS_COUNT; ++i) {
+        fprintf(out, "timer_frame_interval_seconds_bucket{le=\"%g\"} %llu\n", metrics_frame_buckets[i],
+                (unsigned long long) snapshot->frame_buckets[i]);
+    }
+    fprintf(out, "timer_frame_interval_seconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long) snapshot->frames);
+    fprintf(out, "timer_frame_interval_seconds_sum %.9f\n", snapshot->total_interval_ns / 1e9);
+    fprintf(out, "timer_frame_interval_seconds_count %llu\n", (unsigned long long) snapshot->frames);
+    fprintf(out, "# HELP timer_x_events_total Window system events processed.\n");
+    fprintf(out, "# TYPE timer_x_events_total counter\n");
+    fprintf(out, "timer_x_events_total %llu\n", (unsigned long long) snapshot->x_events);
+    fprintf(out, "# HELP timer_displayed_seconds Time currently shown by the timer.\n");
+    fprintf(out, "# TYPE timer_displayed_seconds gauge\n");
+    fprintf(out, "timer_displayed_seconds %.3f\n", snapshot->displayed_time);
+    fprintf(out, "# HELP timer_paused Whether the timer is paused.\n");
+    fprintf(out, "# TYPE timer_paused gauge\n");
+    fprintf(out, "timer_paused %d\n", snapshot->paused ? 1 : 0);
+    fprintf(out, "# HELP timer_last_frame_timestamp_seconds Wall clock time of the newest exported frame.\n");
+    fprintf(out, "# TYPE timer_last_frame_timestamp_seconds gauge\n");
+    fprintf(out, "timer_last_frame_timestamp_seconds %.3f\n", snapshot->timestamp);
+
+    if (fclose(out) != 0 || rename(temp_path, metrics.path) < 0) {
+        fprintf(stderr, "WARNING: could not write metrics `%s`: %s\n", metrics.path, strerror(errno));
+        unlink(temp_path);
+    }
+}
+
+static void *metrics_writer(void *arg) {
+    (void) arg;
+    pthread_mutex_lock(&metrics.mutex);
+    while (!metrics.quit) {
+        struct timespec next = metrics_deadline(metrics.interval_ns);
+        while (!metrics.quit && pthread_cond_timedwait(&metrics.cond, &metrics.mutex, &next) != ETIMEDOUT) {}
+        if (metrics.quit) break;
+
+        atomic_store(&metrics.requested, 1);
+        struct timespec give_up = metrics_deadline(METRICS_SNAPSHOT_TIMEOUT_NS);
+        while (!metrics.quit && atomic_load(&metrics.requested)) {
+            // a stalled render thread leaves the old snapshot in place
+            if (pthread_cond_timedwait(&metrics.cond, &metrics.mutex, &give_up) == ETIMEDOUT) break;
+        }
+        if (!metrics.snapshot.valid) continue;
+        Metrics_Snapshot snapshot = metrics.snapshot;
+
+        pthread_mutex_unlock(&metrics.mutex);
+        metrics_write(&snapshot);
+        pthread_mutex_lock(&metrics.mutex);
+    }
+    pthread_mutex_unlock(&metrics.mutex);
+    return NULL;
+}
+
+static void metrics_take_snapshot(const State *state) {
+    Metrics_Snapshot *snapshot = &metrics.snapshot;
+    snapshot->valid = true;
+    snapshot->frames = frame_stats.frames;
+    snapshot->missed_deadlines = frame_stats.missed_deadlines;
+    snapshot->total_interval_ns = frame_stats.total_interval_ns;
+    uint64_t seen = 0;
+    size_t bucket = 0;
+    for (size_t i = 0; i < METRICS_FRAME_BUCKETS_COUNT; ++i) {
+        size_t end = (size_t) llround(metrics_frame_buckets[i] * 1e6 / FRAME_STATS_BUCKET_US);
+        for (; bucket < end && bucket < FRAME_STATS_BUCKETS - 1; ++bucket) seen += frame_stats.buckets[bucket];
+        snapshot->frame_buckets[i] = seen;
+    }
+    snapshot->x_events = metrics.x_events;
+    snapshot->displayed_time = state->displayed_time;
+    snapshot->paused = state->paused;
+    snapshot->timestamp = clock_ns(CLOCK_REALTIME) / 1e9;
+}
+
+void metrics_begin(const char *path, float interval) {
+    if (!path) return;
+    metrics.path = path;
+    metrics.interval_ns = (int64_t) ((double) (interval > 0.0f ? interval : METRICS_DEFAULT_INTERVAL) * 1e9);
+
+    // the deadlines above are on CLOCK_MONOTONIC, so a clock step cannot stall the writer
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_destroy(&metrics.cond);
+    pthread_cond_init(&metrics.cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    int error = pthread_create(&metrics.thread, NULL, metrics_writer, NULL);
+    if (error != 0) {
+        fprintf(stderr, "WARNING: could not start metrics writer, --metrics ignored: %s\n", strerror(error));
+        return;
+    }
+    metrics.active = true;
+}
+
+// Call once per processed window event
+void metrics_event(void) {
+    metrics.x_events++;
+}
+
+// Call once per frame, one atomic load unless the writer is waiting
+void metrics_update(const State *state) {
+    if (!atomic_load_explicit(&metrics.requested, memory_order_relaxed)) return;
+    pthread_mutex_lock(&metrics.mutex);
+    metrics_take_snapshot(state);
+    atomic_store(&metrics.requested, 0);
+    pthread_cond_signal(&metrics.cond);
+    pthread_mutex_unlock(&metrics.mutex);
+}
+
+// Stops the writer and publishes the final numbers
+void metrics_end(const State *state) {
+    if (!metrics.active) return;
+    pthread_mutex_lock(&metrics.mutex);
+    metrics.quit = true;
+    pthread_cond_signal(&metrics.cond);
+    pthread_mutex_unlock(&metrics.mutex);
+    pthread_join(metrics.thread, NULL);
+    metrics.active = false;
+
+    metrics_take_snapshot(state);
+    metrics_write(&metrics.snapshot);
+}
@@ -0,0 +1,230 @@
+#include <dirent.h>
+#include <sys/prctl.h>
+
+// Power policy for the window loop. The frame rate follows the least demanding
+// of the window and timer states: a hidden (minimized or fully occluded)
+// window needs one frame per second for the title, a paused timer only the
+// penger, an unfocused window is merely glanced at, and on battery the full
+// rate is halved. Whenever the rate drops the frame deadline is handed to the
+// kernel with PR_SET_TIMERSLACK, so our wakeups can be batched with others
+// and the CPU gets to stay in deep C-states for longer.
+//
+// Battery status is read from `--power-supply DIR` (default
+// /sys/class/power_supply): the supplies of type Battery are looked up once,
+// then their status files are reread every few seconds. Pointing DIR at a
+// directory of fake supplies is how the policy is tested.
+//
+// `--bench-power DURATION` forces every state in turn for DURATION and prints
+// wakeups per second for each, powertop style.
+
+#define POWER_SUPPLY_DEFAULT "/sys/class/power_supply"
+#define POWER_BATTERIES_CAP 4
+#define POWER_PATH_CAP 512
+#define POWER_BATTERY_POLL_NS (5 * 1000000000LL)
+#define POWER_SLACK_FRACTION 10 // slack is a tenth of the frame interval
+#define POWER_SLACK_MAX_NS (50 * 1000000LL)
+
+typedef enum {
+    POWER_ACTIVE = 0,
+    POWER_BATTERY,
+    POWER_UNFOCUSED,
+    POWER_PAUSED,
+    POWER_HIDDEN,
+    COUNT_POWER_STATES,
+} Power_State;
+
+static const char *power_state_names[COUNT_POWER_STATES] = {
+    [POWER_ACTIVE]    = "active",
+    [POWER_BATTERY]   = "battery",
+    [POWER_UNFOCUSED] = "unfocused",
+    [POWER_PAUSED]    = "paused",
+    [POWER_HIDDEN]    = "hidden",
+};
+
+// Frames per second the state needs at most; the monitor's refresh rate
+// (halved on battery) is the upper bound
+static const int power_state_fps[COUNT_POWER_STATES] = {
+    [POWER_ACTIVE]    = 0,
+    [POWER_BATTERY]   = 0,
+    [POWER_UNFOCUSED] = 15,
+    [POWER_PAUSED]    = 5,
+    [POWER_HIDDEN]    = 1,
+};
+
+static int64_t power_state_interval_ns(Power_State state) {
+    int64_t refresh_ns = refresh_interval_ns();
+    if (state == POWER_BATTERY) return 2 * refresh_ns;
+    if (power_state_fps[state] == 0) return refresh_ns;
+    int64_t interval_ns = 1000000000LL / power_state_fps[state];
+    return interval_ns > refresh_ns ? interval_ns : refresh_ns;
+}
+
+typedef struct {
+    uint64_t wakeups;
+    uint64_t context_switches;
+    int64_t cpu_ns;
+    int64_t wall_ns;
+} Power_Sample;
+
+typedef struct {
+    char battery_status[POWER_BATTERIES_CAP][POWER_PATH_CAP];
+    size_t batteries_count;
+    int64_t next_battery_poll_ns;
+    int on_battery;
+    int focused;
+    int minimized;
+    Power_State state;
+    int64_t interval_ns;
+
+    // --bench-power
+    int bench;
+    int64_t bench_state_ns;
+    int64_t bench_next_ns;
+    Power_State bench_state;
+    Power_Sample bench_start;
+    Power_Sample bench_results[COUNT_POWER_STATES];
+} Power;
+
+static Power power = {0};
+
+static bool power_read_file(const char *path, char *buffer, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    ssize_t n = read(fd, buffer, size - 1);
+    close(fd);
+    if (n < 0) return false;
+    while (n > 0 && (buffer[n - 1] == '\n' || buffer[n - 1] == ' ')) n--;
+    buffer[n] = '\0';
+    return true;
+}
+
+static void power_find_batteries(const char *supply_path) {
+    DIR *dir = opendir(supply_path);
+    if (!dir) return; // desktops without the class at all
+    struct dirent *entry;
+    while ((entry = readdir(dir)) && power.batteries_count < POWER_BATTERIES_CAP) {
+        if (entry->d_name[0] == '.') continue;
+        char path[POWER_PATH_CAP];
+        char type[32];
+        snprintf(path, sizeof(path), "%s/%s/type", supply_path, entry->d_name);
+        if (!power_read_file(path, type, sizeof(type)) || strcmp(type, "Battery") != 0) continue;
+        snprintf(power.battery_status[power.batteries_count++], POWER_PATH_CAP, "%s/%s/status", supply_path, entry->d_name);
+    }
+    closedir(dir);
+}
+
+// Open/read/close only, so the steady state stays allocation-free
+static void power_poll_battery(void) {
+    power.on_battery = 0;
+    for (size_t i = 0; i < power.batteries_count; ++i) {
+        char status[32];
+        if (power_read_file(power.battery_status[i], status, sizeof(status)) && strcmp(status, "Discharging") == 0) {
+            power.on_battery = 1;
+        }
+    }
+}
+
+static void power_sample(Power_Sample *sample) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    sample->wakeups = reactor.wakeups;
+    sample->context_switches = (uint64_t) (usage.ru_nvcsw + usage.ru_nivcsw);
+    sample->cpu_ns = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000LL +
+                     (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000LL;
+    sample->wall_ns = clock_ns(CLOCK_MONOTONIC);
+}
+
+static void power_apply(Power_State state) {
+    int64_t interval_ns = power_state_interval_ns(state);
+    if (state == power.state && interval_ns == power.interval_ns) return;
+    power.state = state;
+    power.interval_ns = interval_ns;
+
+    bool idle = state != POWER_ACTIVE;
+    int64_t slack_ns = idle ? interval_ns / POWER_SLACK_FRACTION : 0; // 0 restores the default slack
+    if (slack_ns > POWER_SLACK_MAX_NS) slack_ns = POWER_SLACK_MAX_NS;
+    prctl(PR_SET_TIMERSLACK, (unsigned long) slack_ns, 0, 0, 0);
+    reactor_set_frame_interval(interval_ns, idle);
+}
+
+void power_begin(RGFW_window *win, const char *supply_path, float bench_seconds) {
+    power_find_batteries(supply_path ? supply_path : POWER_SUPPLY_DEFAULT);
+    power_poll_battery();
+    power.next_battery_poll_ns = clock_ns(CLOCK_MONOTONIC) + POWER_BATTERY_POLL_NS;
+    power.focused = (win->_flags & RGFW_windowFocus) != 0;
+    power.minimized = RGFW_window_isMinimized(win);
+    power.state = POWER_ACTIVE;
+    power.interval_ns = refresh_interval_ns();
+    window_watch_visibility(win);
+
+    if (bench_seconds > 0.0f) {
+        power.bench = 1;
+        power.bench_state_ns = (int64_t) ((double) bench_seconds * 1e9);
+        power.bench_state = POWER_ACTIVE;
+        power_apply(POWER_ACTIVE);
+        power_sample(&power.bench_start);
+        power.bench_next_ns = power.bench_start.wall_ns + power.bench_state_ns;
+    }
+}
+
+void power_event(RGFW_eventType type) {
+    switch (type) {
+        case RGFW_focusIn: power.focused = 1; break;
+        case RGFW_focusOut: power.focused = 0; break;
+        case RGFW_windowMinimized: power.minimized = 1; break;
+        case RGFW_windowRestored: power.minimized = 0; break;
+        default: break;
+    }
+}
+
+// Steps through the states while benchmarking, returns true when done
+static bool power_bench_update(int64_t now_ns) {
+    if (now_ns < power.bench_next_ns) return false;
+    Power_Sample end;
+    power_sample(&end);
+    Power_Sample *result = &power.bench_results[power.bench_state];
+    result->wakeups = end.wakeups - power.bench_start.wakeups;
+    result->context_switches = end.context_switches - power.bench_start.context_switches;
+    result->cpu_ns = end.cpu_ns - power.bench_start.cpu_ns;
+    result->wall_ns = end.wall_ns - power.bench_start.wall_ns;
+    if (power.bench_state + 1 == COUNT_POWER_STATES) return true;
+
+    power.bench_state++;
+    power_apply(power.bench_state);
+    power_sample(&power.bench_start);
+    power.bench_next_ns = power.bench_start.wall_ns + power.bench_state_ns;
+    return false;
+}
+
+// Call once per frame; returns true when --bench-power is done
+bool power_update(const State *state, int64_t now_ns) {
+    if (power.bench) return power_bench_update(now_ns);
+
+    if (now_ns >= power.next_battery_poll_ns) {
+        power_poll_battery();
+        power.next_battery_poll_ns = now_ns + POWER_BATTERY_POLL_NS;
+    }
+    Power_State next = POWER_ACTIVE;
+    if (power.minimized || window_occluded()) next = POWER_HIDDEN;
+    else if (state->paused) next = POWER_PAUSED;
+    else if (!power.focused) next = POWER_UNFOCUSED;
+    else if (power.on_battery) next = POWER_BATTERY;
+    power_apply(next);
+    return false;
+}
+
+int64_t power_frame_interval_ns(void) {
+    return power.interval_ns;
+}
+
+void power_bench_report(FILE *out) {
+    if (!power.bench) return;
+    fprintf(out, "%-10s %5s %12s %18s %12s\n", "state", "fps", "wakeups/s", "ctx switches/s", "cpu ms/s");
+    for (size_t i = 0; i < COUNT_POWER_STATES; ++i) {
+        const Power_Sample *r = &power.bench_results[i];
+        double seconds = r->wall_ns / 1e9;
+        if (seconds <= 0.0) continue;
+        fprintf(out, "%-10s %5.1f %12.1f %18.1f %12.2f\n", power_state_names[i], 1e9 / power_state_interval_ns((Power_State) i),
+                r->wakeups / seconds, r->context_switches / seconds, r->cpu_ns / 1e6 / seconds);
+    }
+}
@@ -0,0 +1,256 @@
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+
+// Single wait point of the window loop. Instead of a fixed RGFW_sleep, the
+// loop sleeps in one epoll_wait on the X connection, a periodic frame timerfd,
+// a signalfd (SIGUSR1 toggles pause, SIGUSR2 resets, SIGRTMIN writes the trace)
+// and, with `--commands`, stdin lines (pause, resume, toggle, reset, trace, quit). It returns as soon as the
+// next frame is due or X has a visible event for us; signals and commands are
+// turned into Reactor_Command bits for the loop to apply. X only cuts the
+// sleep short for events that change the picture (keys, resize, expose, ...);
+// pointer motion is dropped and the rest waits for the frame timer, so moving
+// the mouse over the window does not raise the frame rate. Every return of
+// epoll_wait is counted as a wakeup.
+
+#define REACTOR_LINE_CAP 128
+
+typedef enum {
+    REACTOR_TOGGLE_PAUSE = 1 << 0,
+    REACTOR_PAUSE        = 1 << 1,
+    REACTOR_RESUME       = 1 << 2,
+    REACTOR_RESET        = 1 << 3,
+    REACTOR_QUIT         = 1 << 4,
+    REACTOR_FLUSH_TRACE  = 1 << 5,
+} Reactor_Command;
+
+typedef enum {
+    REACTOR_SOURCE_X = 0,
+    REACTOR_SOURCE_FRAME,
+    REACTOR_SOURCE_SIGNAL,
+    REACTOR_SOURCE_STDIN,
+    COUNT_REACTOR_SOURCES,
+} Reactor_Source;
+
+static const char *reactor_source_names[COUNT_REACTOR_SOURCES] = {
+    [REACTOR_SOURCE_X]      = "X",
+    [REACTOR_SOURCE_FRAME]  = "frame timer",
+    [REACTOR_SOURCE_SIGNAL] = "signal",
+    [REACTOR_SOURCE_STDIN]  = "stdin",
+};
+
+typedef struct {
+    int epoll_fd;
+    int frame_fd;
+    int signal_fd;
+    int stdin_active;
+    RGFW_window *win;
+    int64_t frame_interval_ns;
+    bool coalesce;
+    int64_t next_frame_ns; // only kept when coalescing
+    char line[REACTOR_LINE_CAP];
+    size_t line_size;
+    int64_t start_ns;
+    uint64_t wakeups;
+    uint64_t source_wakeups[COUNT_REACTOR_SOURCES];
+    uint64_t missed_frames; // frame timer expirations beyond the first per wakeup
+} Reactor;
+
+static Reactor reactor = {.epoll_fd = -1, .frame_fd = -1, .signal_fd = -1};
+
+// Must run before any thread is started, so that every thread inherits the
+// mask and the signals can only ever be picked up through the signalfd
+void reactor_block_signals(void) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    sigaddset(&set, SIGUSR2);
+    sigaddset(&set, SIGRTMIN);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+}
+
+static bool reactor_watch(int fd, Reactor_Source source) {
+    struct epoll_event event = {.events = EPOLLIN, .data.u32 = source};
+    if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        fprintf(stderr, "ERROR: could not watch the %s fd: %s\n", reactor_source_names[source], strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// A timerfd fires exactly on time, which is what smooth animation wants. When
+// coalesce is set the frame deadline becomes an epoll_wait timeout instead,
+// because unlike timerfd that honours the thread's PR_SET_TIMERSLACK and lets
+// the kernel batch the wakeup with others.
+void reactor_set_frame_interval(int64_t interval_ns, bool coalesce) {
+    reactor.frame_interval_ns = interval_ns;
+    reactor.coalesce = coalesce;
+    reactor.next_frame_ns = clock_ns(CLOCK_MONOTONIC) + interval_ns;
+    struct itimerspec its = {0};
+    if (!coalesce) {
+        its.it_interval.tv_sec = interval_ns / 1000000000;
+        its.it_interval.tv_nsec = interval_ns % 1000000000;
+        its.it_value = its.it_interval;
+    }
+    timerfd_settime(reactor.frame_fd, 0, &its, NULL);
+}
+
+static int reactor_timeout_ms(void) {
+    if (!reactor.coalesce) return -1;
+    int64_t remaining_ns = reactor.next_frame_ns - clock_ns(CLOCK_MONOTONIC);
+    if (remaining_ns <= 0) return 0;
+    return (int) ((remaining_ns + 999999) / 1000000);
+}
+
+bool reactor_begin(RGFW_window *win, int64_t frame_interval_ns, bool commands) {
+    reactor.win = win;
+    reactor.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor.epoll_fd < 0) {
+        fprintf(stderr, "ERROR: could not create epoll instance: %s\n", strerror(errno));
+        return false;
+    }
+
+    reactor.frame_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (reactor.frame_fd < 0) {
+        fprintf(stderr, "ERROR: could not create frame timer: %s\n", strerror(errno));
+        return false;
+    }
+    reactor_set_frame_interval(frame_interval_ns, false);
+
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    sigaddset(&set, SIGUSR2);
+    sigaddset(&set, SIGRTMIN);
+    reactor.signal_fd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (reactor.signal_fd < 0) {
+        fprintf(stderr, "ERROR: could not create signalfd: %s\n", strerror(errno));
+        return false;
+    }
+
+    if (!reactor_watch(window_connection_fd(win), REACTOR_SOURCE_X)) return false;
+    if (!reactor_watch(reactor.frame_fd, REACTOR_SOURCE_FRAME)) return false;
+    if (!reactor_watch(reactor.signal_fd, REACTOR_SOURCE_SIGNAL)) return false;
+    if (commands) {
+        fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+        struct epoll_event event = {.events = EPOLLIN, .data.u32 = REACTOR_SOURCE_STDIN};
+        if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &event) == 0) {
+            reactor.stdin_active = 1;
+        } else {
+            // EPERM: regular files and /dev/null cannot be waited on
+            fprintf(stderr, "WARNING: stdin cannot be waited on, --commands ignored: %s\n", strerror(errno));
+        }
+    }
+    reactor.start_ns = clock_ns(CLOCK_MONOTONIC);
+    return true;
+}
+
+void reactor_end(void) {
+    if (reactor.epoll_fd >= 0) close(reactor.epoll_fd);
+    if (reactor.frame_fd >= 0) close(reactor.frame_fd);
+    if (reactor.signal_fd >= 0) close(reactor.signal_fd);
+    reactor.epoll_fd = reactor.frame_fd = reactor.signal_fd = -1;
+}
+
+static unsigned reactor_parse_command(const char *line) {
+    if (strcmp(line, "pause") == 0) return REACTOR_PAUSE;
+    if (strcmp(line, "resume") == 0) return REACTOR_RESUME;
+    if (strcmp(line, "toggle") == 0) return REACTOR_TOGGLE_PAUSE;
+    if (strcmp(line, "reset") == 0) return REACTOR_RESET;
+    if (strcmp(line, "trace") == 0) return REACTOR_FLUSH_TRACE;
+    if (strcmp(line, "quit") == 0) return REACTOR_QUIT;
+    if (line[0] != '\0') fprintf(stderr, "WARNING: unknown command `%s`, expected pause, resume, toggle, reset, trace or quit\n", line);
+    return 0;
+}
+
+static unsigned reactor_read_stdin(void) {
+    unsigned commands = 0;
+    char buffer[REACTOR_LINE_CAP];
+    ssize_t n;
+    while ((n = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < n; ++i) {
+            if (buffer[i] == '\n') {
+                reactor.line[reactor.line_size] = '\0';
+                commands |= reactor_parse_command(reactor.line);
+                reactor.line_size = 0;
+            } else if (reactor.line_size < REACTOR_LINE_CAP - 1) {
+                reactor.line[reactor.line_size++] = buffer[i];
+            }
+        }
+    }
+    if (n == 0) {
+        // EOF: stop watching, otherwise stdin stays readable forever
+        epoll_ctl(reactor.epoll_fd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+        reactor.stdin_active = 0;
+    }
+    return commands;
+}
+
+static unsigned reactor_read_signals(void) {
+    unsigned commands = 0;
+    struct signalfd_siginfo info;
+    while (read(reactor.signal_fd, &info, sizeof(info)) == (ssize_t) sizeof(info)) {
+        if (info.ssi_signo == SIGUSR1) commands ^= REACTOR_TOGGLE_PAUSE;
+        if (info.ssi_signo == SIGUSR2) commands |= REACTOR_RESET;
+        if ((int) info.ssi_signo == SIGRTMIN) commands |= REACTOR_FLUSH_TRACE;
+    }
+    return commands;
+}
+
+// Sleeps until the next frame is due or X has visible events, returns the
+// commands that came in meanwhile
+unsigned reactor_wait(void) {
+    unsigned commands = 0;
+    // Xlib may already hold events it read while waiting for a reply
+    if (window_pending_visible(reactor.win)) return 0;
+
+    for (;;) {
+        struct epoll_event events[COUNT_REACTOR_SOURCES];
+        int n = epoll_wait(reactor.epoll_fd, events, COUNT_REACTOR_SOURCES, reactor_timeout_ms());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "ERROR: epoll_wait failed: %s\n", strerror(errno));
+            return REACTOR_QUIT;
+        }
+        reactor.wakeups++;
+
+        bool frame = false;
+        if (reactor.coalesce && reactor_timeout_ms() == 0) {
+            reactor.source_wakeups[REACTOR_SOURCE_FRAME] += n == 0;
+            reactor.next_frame_ns += reactor.frame_interval_ns;
+            int64_t now_ns = clock_ns(CLOCK_MONOTONIC);
+            if (reactor.next_frame_ns <= now_ns) {
+                reactor.missed_frames += (uint64_t) ((now_ns - reactor.next_frame_ns) / reactor.frame_interval_ns);
+                reactor.next_frame_ns = now_ns + reactor.frame_interval_ns;
+            }
+            frame = true;
+        }
+        for (int i = 0; i < n; ++i) {
+            Reactor_Source source = (Reactor_Source) events[i].data.u32;
+            reactor.source_wakeups[source]++;
+            switch (source) {
+                case REACTOR_SOURCE_FRAME: {
+                    uint64_t expirations = 0;
+                    if (read(reactor.frame_fd, &expirations, sizeof(expirations)) == (ssize_t) sizeof(expirations) && expirations > 1) {
+                        reactor.missed_frames += expirations - 1;
+                    }
+                    frame = true;
+                } break;
+                case REACTOR_SOURCE_X: frame |= window_pending_visible(reactor.win); break;
+                case REACTOR_SOURCE_SIGNAL: commands |= reactor_read_signals(); break;
+                case REACTOR_SOURCE_STDIN: commands |= reactor_read_stdin(); break;
+                default: break;
+            }
+        }
+        if (frame || commands) return commands;
+    }
+}
+
+void reactor_report(FILE *out) {
+    double seconds = (clock_ns(CLOCK_MONOTONIC) - reactor.start_ns) / 1e9;
+    if (seconds <= 0.0) return;
+    fprintf(out, "wakeups            %.1f/s (", reactor.wakeups / seconds);
+    for (size_t i = 0; i < COUNT_REACTOR_SOURCES; ++i) {
+        fprintf(out, "%s%s %.1f/s", i ? ", " : "", reactor_source_names[i], reactor.source_wakeups[i] / seconds);
+    }
+    fprintf(out, "), %llu frame ticks missed\n", (unsigned long long) reactor.missed_frames);
+}
@@ -0,0 +1,201 @@
+// Frame interval matched to the refresh rate of the monitor the window is on,
+// looked up through XRandR: the CRTC whose rectangle holds the window centre
+// gives the mode, and the mode's dot clock and totals give the exact period
+// (so 59.94 Hz stays 59.94 Hz). It is looked up again, at most every
+// REFRESH_RECHECK_NS, after the window moved or XRandR signalled a screen or
+// CRTC change. FPS is the fallback when XRandR has no answer; `--fps N` skips
+// the lookup altogether.
+//
+// The lookup is 2 + one per CRTC blocking round trips to the X server. Only
+// the first one, before the loop starts, runs on the render thread. Later ones
+// are handed to a worker thread with its own X connection, and the answer is
+// picked up on a later frame. Without that connection they run on the render
+// thread and stall the frame they land in.
+
+#define REFRESH_RECHECK_NS (250 * 1000000LL)
+
+typedef struct {
+    int override_fps;
+    int randr; // XRandR is available and events are selected
+    int event_base;
+    int dirty;
+    int64_t last_check_ns;
+    int64_t interval_ns;
+
+    bool worker;
+    Display *display; // the worker's own connection
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool quit;
+    bool requested;
+    Window request_window;
+    int request_x, request_y;
+    atomic_int answered; // answer_ns is ready, checked every frame without the lock
+    int64_t answer_ns;
+} Refresh;
+
+static Refresh refresh = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static int64_t refresh_mode_interval_ns(const XRRModeInfo *mode) {
+    if (mode->dotClock == 0 || mode->hTotal == 0 || mode->vTotal == 0) return 0;
+    double lines = (double) mode->vTotal;
+    if (mode->modeFlags & RR_DoubleScan) lines *= 2.0;
+    if (mode->modeFlags & RR_Interlace) lines /= 2.0;
+    return (int64_t) ((double) mode->hTotal * lines * 1e9 / (double) mode->dotClock);
+}
+
+// Refresh period of the CRTC holding the point (x, y) of the window, 0 when
+// unknown. Blocks on the X server.
+static int64_t refresh_query(Display *display, Window window, int x, int y) {
+    Window root = DefaultRootWindow(display);
+    Window child;
+    XTranslateCoordinates(display, window, root, x, y, &x, &y, &child);
+
+    XRRScreenResources *resources = XRRGetScreenResourcesCurrent(display, root);
+    if (!resources) return 0;
+    int64_t interval_ns = 0;
+    int64_t fallback_ns = 0; // first active CRTC, for a window that is off every screen
+    for (int i = 0; i < resources->ncrtc && interval_ns == 0; ++i) {
+        XRRCrtcInfo *crtc = XRRGetCrtcInfo(display, resources, resources->crtcs[i]);
+        if (!crtc) continue;
+        if (crtc->mode != None) {
+            for (int m = 0; m < resources->nmode; ++m) {
+                if (resources->modes[m].id != crtc->mode) continue;
+                int64_t mode_ns = refresh_mode_interval_ns(&resources->modes[m]);
+                if (fallback_ns == 0) fallback_ns = mode_ns;
+                if (x >= crtc->x && x < crtc->x + (int) crtc->width && y >= crtc->y && y < crtc->y + (int) crtc->height) {
+                    interval_ns = mode_ns;
+                }
+                break;
+            }
+        }
+        XRRFreeCrtcInfo(crtc);
+    }
+    XRRFreeScreenResources(resources);
+    return interval_ns ? interval_ns : fallback_ns;
+}
+
+// Takes a new period, returns true when the frame interval changed
+static bool refresh_apply(int64_t interval_ns) {
+    if (interval_ns < 1000000000LL / FPS_MAX || interval_ns > 1000000000LL / FPS_MIN) return false;
+    if (interval_ns == refresh.interval_ns) return false;
+    refresh.interval_ns = interval_ns;
+    fprintf(stderr, "INFO: monitor refreshes at %.2f Hz, frame budget %.3fms\n", 1e9 / interval_ns, interval_ns / 1e6);
+    return true;
+}
+
+static void *refresh_worker(void *arg) {
+    (void) arg;
+    pthread_mutex_lock(&refresh.mutex);
+    for (;;) {
+        while (!refresh.quit && !refresh.requested) pthread_cond_wait(&refresh.cond, &refresh.mutex);
+        if (refresh.quit) break;
+        refresh.requested = false;
+        Window window = refresh.request_window;
+        int x = refresh.request_x, y = refresh.request_y;
+
+        pthread_mutex_unlock(&refresh.mutex);
+        int64_t interval_ns = refresh_query(refresh.display, window, x, y);
+        pthread_mutex_lock(&refresh.mutex);
+
+        refresh.answer_ns = interval_ns;
+        atomic_store(&refresh.answered, 1);
+    }
+    pthread_mutex_unlock(&refresh.mutex);
+    return NULL;
+}
+
+static void refresh_start_worker(RGFW_window *win) {
+    refresh.display = XOpenDisplay(XDisplayString(win->src.display));
+    if (!refresh.display) {
+        fprintf(stderr, "WARNING: could not open a second X connection, refresh rate lookups will block frames\n");
+        return;
+    }
+    int error = pthread_create(&refresh.thread, NULL, refresh_worker, NULL);
+    if (error != 0) {
+        fprintf(stderr, "WARNING: could not start refresh rate worker, lookups will block frames: %s\n", strerror(error));
+        XCloseDisplay(refresh.display);
+        refresh.display = NULL;
+        return;
+    }
+    refresh.worker = true;
+}
+
+void refresh_begin(RGFW_window *win, int override_fps) {
+    refresh.override_fps = override_fps;
+    refresh.interval_ns = 1000000000LL / (override_fps > 0 ? override_fps : FPS);
+    if (override_fps > 0) return;
+
+    int error_base;
+    if (!XRRQueryExtension(win->src.display, &refresh.event_base, &error_base)) {
+        fprintf(stderr, "WARNING: no XRandR, running at %d FPS (see --fps)\n", FPS);
+        return;
+    }
+    XRRSelectInput(win->src.display, win->src.window, RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask);
+    refresh.randr = 1;
+    refresh.last_check_ns = clock_ns(CLOCK_MONOTONIC);
+    // the loop has not started yet, so this one may block
+    refresh_apply(refresh_query(win->src.display, win->src.window, win->r.w / 2, win->r.h / 2));
+    refresh_start_worker(win);
+}
+
+void refresh_end(void) {
+    if (!refresh.worker) return;
+    pthread_mutex_lock(&refresh.mutex);
+    refresh.quit = true;
+    pthread_cond_signal(&refresh.cond);
+    pthread_mutex_unlock(&refresh.mutex);
+    pthread_join(refresh.thread, NULL);
+    XCloseDisplay(refresh.display);
+    refresh.worker = false;
+}
+
+// Marks the rate stale if this is an XRandR event, returns whether it was
+bool refresh_randr_event(int type) {
+    if (!refresh.randr) return false;
+    if (type != refresh.event_base + RRScreenChangeNotify && type != refresh.event_base + RRNotify) return false;
+    refresh.dirty = 1;
+    return true;
+}
+
+void refresh_event(RGFW_eventType type) {
+    if (type == RGFW_windowMoved || type == RGFW_windowResized) refresh.dirty = 1;
+}
+
+// Call once per frame, returns true when the frame interval changed. Asks the
+// worker for a new lookup and takes its answer frames later.
+bool refresh_update(RGFW_window *win, int64_t now_ns) {
+    if (!refresh.randr) return false;
+    bool changed = false;
+    if (atomic_load_explicit(&refresh.answered, memory_order_relaxed)) {
+        pthread_mutex_lock(&refresh.mutex);
+        int64_t interval_ns = refresh.answer_ns;
+        atomic_store(&refresh.answered, 0);
+        pthread_mutex_unlock(&refresh.mutex);
+        changed = refresh_apply(interval_ns);
+    }
+    if (!refresh.dirty || now_ns - refresh.last_check_ns < REFRESH_RECHECK_NS) return changed;
+    refresh.dirty = 0;
+    refresh.last_check_ns = now_ns;
+
+    if (!refresh.worker) {
+        // no second connection, the round trips land in this frame
+        return refresh_apply(refresh_query(win->src.display, win->src.window, win->r.w / 2, win->r.h / 2)) || changed;
+    }
+    pthread_mutex_lock(&refresh.mutex);
+    refresh.request_window = win->src.window;
+    refresh.request_x = win->r.w / 2;
+    refresh.request_y = win->r.h / 2;
+    refresh.requested = true;
+    pthread_cond_signal(&refresh.cond);
+    pthread_mutex_unlock(&refresh.mutex);
+    return changed;
+}
+
+int64_t refresh_interval_ns(void) {
+    return refresh.interval_ns;
+}
@@ -0,0 +1,143 @@
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+// Opt-in real-time knobs for the render thread: `--sched fifo:PRIO|rr:PRIO`,
+// `--cpu LIST` pinning and `--mlock`, which locks every current and future
+// page and prefaults the sprite arrays and the stack so the steady-state loop
+// takes no page faults. Scheduling and affinity are set on the calling thread
+// only, so threads started before rt_begin (the hogs, the expiry thread) keep
+// their normal policy. mlockall covers every thread, so `--mlock` refuses to
+// run with memory hogs. rt_report prints what getrusage saw during the loop.
+// The affinity mask and RUSAGE_THREAD are spelled out here because the glibc
+// wrappers hide behind _GNU_SOURCE, which would clash with our CHAR_WIDTH.
+
+#ifndef RUSAGE_THREAD
+#define RUSAGE_THREAD 1
+#endif
+
+#define RT_STACK_PREFAULT (256 * 1024)
+#define RT_PAGE_SIZE 4096
+#define RT_CPUS_CAP 1024
+#define RT_MASK_BITS (8 * sizeof(unsigned long))
+
+typedef struct {
+    int policy;   // SCHED_OTHER when not requested
+    int priority;
+    unsigned long cpus[RT_CPUS_CAP / RT_MASK_BITS];
+    int cpus_count;
+    int mlock;
+} Rt_Config;
+
+typedef struct {
+    int active;
+    struct rusage start_thread;
+    struct rusage start_process;
+} Rt;
+
+static Rt rt = {0};
+
+// Parses `fifo:PRIO` or `rr:PRIO`
+void parse_rt_sched(Rt_Config *config, const char *text) {
+    const char *prio;
+    if (strncmp(text, "fifo:", 5) == 0) {
+        config->policy = SCHED_FIFO;
+        prio = text + 5;
+    } else if (strncmp(text, "rr:", 3) == 0) {
+        config->policy = SCHED_RR;
+        prio = text + 3;
+    } else {
+        fprintf(stderr, "`%s` is an unknown scheduling policy, expected fifo:PRIO or rr:PRIO\n", text);
+        exit(1);
+    }
+    char *endptr = NULL;
+    config->priority = (int) strtol(prio, &endptr, 10);
+    if (endptr == prio || *endptr != '\0') {
+        fprintf(stderr, "`%s` is not a valid priority\n", prio);
+        exit(1);
+    }
+    int lo = sched_get_priority_min(config->policy), hi = sched_get_priority_max(config->policy);
+    if (config->priority < lo || config->priority > hi) {
+        fprintf(stderr, "`%d` is out of range, the priority must be between %d and %d\n", config->priority, lo, hi);
+        exit(1);
+    }
+}
+
+// Parses a comma separated list of CPUs and ranges like `2,4-5`
+void parse_rt_cpus(Rt_Config *config, const char *text) {
+    memset(config->cpus, 0, sizeof(config->cpus));
+    config->cpus_count = 0;
+    const char *p = text;
+    while (*p) {
+        char *endptr;
+        long first = strtol(p, &endptr, 10);
+        long last = first;
+        if (endptr != p && *endptr == '-') {
+            p = endptr + 1;
+            last = strtol(p, &endptr, 10);
+        }
+        if (endptr == p || first < 0 || last < first || last >= RT_CPUS_CAP || (*endptr != ',' && *endptr != '\0')) {
+            fprintf(stderr, "`%s` is not a valid CPU list, expected something like 2 or 0,2-3\n", text);
+            exit(1);
+        }
+        for (long cpu = first; cpu <= last; ++cpu) config->cpus[cpu / RT_MASK_BITS] |= 1UL << (cpu % RT_MASK_BITS);
+        config->cpus_count += (int) (last - first + 1);
+        p = *endptr == ',' ? endptr + 1 : endptr;
+    }
+}
+
+bool rt_requested(const Rt_Config *config) {
+    return config->policy != SCHED_OTHER || config->cpus_count > 0 || config->mlock;
+}
+
+// Touches every page of the buffer so the first frame does not fault it in
+void rt_prefault(const void *data, size_t size) {
+    const volatile unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i += RT_PAGE_SIZE) (void) bytes[i];
+    if (size > 0) (void) bytes[size - 1];
+}
+
+__attribute__((noinline)) static void rt_prefault_stack(void) {
+    volatile unsigned char stack[RT_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(stack); i += RT_PAGE_SIZE) stack[i] = 0;
+}
+
+// Applies the config to the calling thread. Failures are warnings: a timer
+// without real-time priority is still better than no timer.
+void rt_begin(const Rt_Config *config) {
+    if (config->mlock) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+            fprintf(stderr, "WARNING: could not lock memory (see ulimit -l): %s\n", strerror(errno));
+        }
+        rt_prefault_stack();
+    }
+    if (config->cpus_count > 0 && syscall(SYS_sched_setaffinity, 0, sizeof(config->cpus), config->cpus) < 0) {
+        fprintf(stderr, "WARNING: could not pin the render thread: %s\n", strerror(errno));
+    }
+    if (config->policy != SCHED_OTHER) {
+        struct sched_param param = {.sched_priority = config->priority};
+        int err = pthread_setschedparam(pthread_self(), config->policy, &param);
+        if (err != 0) {
+            fprintf(stderr, "WARNING: could not switch to %s priority %d (needs CAP_SYS_NICE or an rtprio limit): %s\n",
+                    config->policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR", config->priority, strerror(err));
+        }
+    }
+    getrusage(RUSAGE_THREAD, &rt.start_thread);
+    getrusage(RUSAGE_SELF, &rt.start_process);
+    rt.active = 1;
+}
+
+void rt_report(FILE *out) {
+    if (!rt.active) return;
+    struct rusage thread, process;
+    getrusage(RUSAGE_THREAD, &thread);
+    getrusage(RUSAGE_SELF, &process);
+    fprintf(out, "render thread since the loop started: %ld minor faults, %ld major faults, %ld involuntary / %ld voluntary context switches\n",
+            thread.ru_minflt - rt.start_thread.ru_minflt, thread.ru_majflt - rt.start_thread.ru_majflt,
+            thread.ru_nivcsw - rt.start_thread.ru_nivcsw, thread.ru_nvcsw - rt.start_thread.ru_nvcsw);
+    fprintf(out, "whole process in total:              %ld minor faults, %ld major faults, %ld involuntary / %ld voluntary context switches\n",
+            process.ru_minflt, process.ru_majflt, process.ru_nivcsw, process.ru_nvcsw);
+}
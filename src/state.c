@@ -1,6 +1,10 @@
 #include <math.h>
+#include <signal.h>
 
-#define FPS 60
+#define FPS 60 // fallback when the monitor refresh rate is unknown
+#define FPS_MIN 1
+#define FPS_MAX 1000
+#define GPU_QUEUE_MAX 3 // deepest render-ahead --gpu-queue accepts
 #define COLON_INDEX 10
 #define SPRITE_CHAR_WIDTH (300 / 2)
 #define SPRITE_CHAR_HEIGHT (380 / 2)
@@ -31,6 +35,21 @@ typedef enum {
     MODE_CLOCK,
 } Mode;
 
+const char *mode_as_cstr(Mode mode) {
+    switch (mode) {
+        case MODE_ASCENDING: return "stopwatch";
+        case MODE_COUNTDOWN: return "countdown";
+        case MODE_CLOCK:     return "clock";
+        default:             return "(Unknown)";
+    }
+}
+
+typedef enum {
+    EMIT_NONE = 0,
+    EMIT_JSON,
+    EMIT_I3BAR,
+} Emit_Format;
+
 // Parses times like "1h30m15s" -> seconds as float
 float parse_time(const char *time) {
     float result = 0.0f;
@@ -60,11 +79,121 @@ float parse_time(const char *time) {
     return result;
 }
 
+// Parses "HH:MM" or "HH:MM:SS", returns what follows or NULL
+static const char *parse_clock_time(const char *text, int *hour, int *minute, int *second) {
+    int n = 0;
+    *second = 0;
+    if (sscanf(text, "%2d:%2d%n", hour, minute, &n) != 2) return NULL;
+    text += n;
+    if (*text == ':') {
+        if (sscanf(text, ":%2d%n", second, &n) != 1) return NULL;
+        text += n;
+    }
+    if (*hour < 0 || *hour > 23 || *minute < 0 || *minute > 59 || *second < 0 || *second > 60) return NULL;
+    return text;
+}
+
+// Parses wall-time deadlines -> UTC nanoseconds. Accepts "17:30" or "17:30:15"
+// (next occurrence in local time) and ISO-8601 like "2025-06-01T17:30",
+// "2025-06-01 17:30:15Z" or "2025-06-01T17:30+02:00". Evaluated once at startup,
+// from then on the wall clock engine tracks it monotonically.
+int64_t parse_deadline(const char *text) {
+    const time_t now = (time_t) (clock_ns(CLOCK_REALTIME) / 1000000000);
+    struct tm tm = {0};
+    int year, month, day, hour, minute, second, n = 0;
+    const char *rest;
+
+    const bool has_date = sscanf(text, "%4d-%2d-%2d%n", &year, &month, &day, &n) == 3 && (text[n] == 'T' || text[n] == ' ');
+    if (has_date) {
+        rest = parse_clock_time(text + n + 1, &hour, &minute, &second);
+        if (!rest) goto invalid;
+        tm.tm_year = year - 1900;
+        tm.tm_mon = month - 1;
+        tm.tm_mday = day;
+    } else {
+        rest = parse_clock_time(text, &hour, &minute, &second);
+        if (!rest || *rest != '\0') goto invalid;
+        localtime_r(&now, &tm);
+    }
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_sec = second;
+
+    time_t deadline;
+    if (*rest == '\0') {
+        tm.tm_isdst = -1;
+        deadline = mktime(&tm);
+        if (!has_date && deadline <= now) {
+            // a bare time of day that already passed today means tomorrow
+            tm.tm_mday += 1;
+            tm.tm_isdst = -1;
+            deadline = mktime(&tm);
+        }
+    } else if (*rest == 'Z' && rest[1] == '\0') {
+        deadline = timegm(&tm);
+    } else if (*rest == '+' || *rest == '-') {
+        // +HH:MM, +HHMM or +HH, with nothing after it
+        const char *offset_text = rest + 1;
+        int offset_hours, offset_minutes = 0, used = 0;
+        if (offset_text[0] < '0' || offset_text[0] > '9') goto invalid;
+        if (sscanf(offset_text, "%2d:%2d%n", &offset_hours, &offset_minutes, &used) != 2 || used != 5) {
+            used = 0;
+            if (sscanf(offset_text, "%2d%2d%n", &offset_hours, &offset_minutes, &used) != 2 || used != 4) {
+                offset_minutes = 0;
+                used = 0;
+                if (sscanf(offset_text, "%2d%n", &offset_hours, &used) != 1 || used != 2) goto invalid;
+            }
+        }
+        if (offset_text[used] != '\0' || offset_hours > 23 || offset_minutes < 0 || offset_minutes > 59) goto invalid;
+        int offset = offset_hours * 3600 + offset_minutes * 60;
+        deadline = timegm(&tm) - (*rest == '+' ? offset : -offset);
+    } else {
+        goto invalid;
+    }
+    if (deadline == (time_t) -1) goto invalid;
+    return (int64_t) deadline * 1000000000;
+
+invalid:
+    fprintf(stderr, "`%s` is not a wall time like 17:30 or 2025-06-01T17:30:00Z\n", text);
+    exit(1);
+}
+
 typedef struct {
     Mode mode;
-    float displayed_time;
+    double displayed_time; // double: a float drifts by seconds when summing 60 dt per second for hours
     int paused;
     int exit_after_countdown;
+    const char *state_file;
+    int tty;
+    Emit_Format emit;
+    const char *on_expire_cmd;
+    const char *on_expire_fifo;
+    int on_expire_pid;
+    int on_expire_signal;
+    int bench_expiry;
+    const char *zones[WALL_CLOCK_ZONES_CAP];
+    size_t zones_count;
+    float zone_times[WALL_CLOCK_ZONES_CAP];
+    int64_t until_ns; // wall-time deadline in UTC nanoseconds, 0 for plain countdowns
+    Suspend_Policy suspend;
+    Clock_Config clock;
+    float simulate; // seconds of virtual time to simulate headless, 0 to run normally
+    float bench_frames; // seconds to run the main loop for and report frame pacing, 0 to run normally
+    int hog_cpu;
+    int hog_memory;
+    Rt_Config rt;
+    int gpu_queue; // frames the GPU may run behind, 0 to leave it to the driver
+    int latency; // measure input-to-photon latency of key presses
+    int fps; // fixed frame rate, 0 to follow the monitor
+    const char *power_supply; // NULL for /sys/class/power_supply
+    const char *trace; // Chrome trace-event JSON output, NULL when not tracing
+    const char *metrics; // Prometheus textfile output, NULL when not exporting
+    float metrics_interval; // seconds between metrics writes, 0 for the default
+    int governor; // shed effects when frames overrun their budget
+    float bench_power; // seconds to spend in every power state, 0 to run normally
+    int commands; // read pause/resume/toggle/reset/quit lines from stdin
+    int xcb; // drive the window through XCB instead of Xlib
+    int check_alloc; // steady-state frames to check for allocations, 0 to run normally
 
     int quit;
     size_t wiggle_index;
@@ -74,17 +203,132 @@ typedef struct {
 } State;
 
 
+// Returns the value following the flag at argv[*i] and steps over it
+const char *arg_value(int argc, char **argv, int *i, const char *what) {
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "`%s` expects %s\n", argv[*i], what);
+        exit(1);
+    }
+    *i += 1;
+    return argv[*i];
+}
+
+int parse_int(const char *flag, const char *value) {
+    char *endptr = NULL;
+    long x = strtol(value, &endptr, 10);
+    if (value == endptr || *endptr != '\0') {
+        fprintf(stderr, "`%s` expects a number, got `%s`\n", flag, value);
+        exit(1);
+    }
+    return (int) x;
+}
+
 void parse_state_from_args(State *state, int argc, char **argv) {
     memset(state, 0, sizeof(*state));
 
     state->wiggle_cooldown = WIGGLE_DURATION;
     state->user_scale = 1.0f;
+    state->on_expire_signal = SIGUSR1;
 
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "-p") == 0) {
             state->paused = 1;
         } else if (strcmp(argv[i], "-e") == 0) {
             state->exit_after_countdown = 1;
+        } else if (strcmp(argv[i], "--state-file") == 0) {
+            state->state_file = arg_value(argc, argv, &i, "a file path");
+        } else if (strcmp(argv[i], "--tty") == 0) {
+            state->tty = 1;
+        } else if (strcmp(argv[i], "--emit") == 0) {
+            const char *format = arg_value(argc, argv, &i, "a format: json or i3bar");
+            if (strcmp(format, "json") == 0) {
+                state->emit = EMIT_JSON;
+            } else if (strcmp(format, "i3bar") == 0) {
+                state->emit = EMIT_I3BAR;
+            } else {
+                fprintf(stderr, "`%s` is an unknown emit format\n", format);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--on-expire-cmd") == 0) {
+            state->on_expire_cmd = arg_value(argc, argv, &i, "a shell command");
+        } else if (strcmp(argv[i], "--on-expire-fifo") == 0) {
+            state->on_expire_fifo = arg_value(argc, argv, &i, "a FIFO path");
+        } else if (strcmp(argv[i], "--on-expire-signal") == 0) {
+            // PID or PID:SIGNAL, SIGUSR1 by default
+            char spec[64];
+            snprintf(spec, sizeof(spec), "%s", arg_value(argc, argv, &i, "a pid"));
+            char *colon = strchr(spec, ':');
+            if (colon) {
+                *colon = '\0';
+                state->on_expire_signal = parse_int("--on-expire-signal", colon + 1);
+            }
+            state->on_expire_pid = parse_int("--on-expire-signal", spec);
+        } else if (strcmp(argv[i], "--bench-expiry") == 0) {
+            state->bench_expiry = parse_int("--bench-expiry", arg_value(argc, argv, &i, "a number of runs"));
+        } else if (strcmp(argv[i], "--tz") == 0) {
+            const char *zone = arg_value(argc, argv, &i, "a time zone like Europe/Berlin");
+            if (state->zones_count >= WALL_CLOCK_ZONES_CAP) {
+                fprintf(stderr, "at most %d time zones are supported\n", WALL_CLOCK_ZONES_CAP);
+                exit(1);
+            }
+            state->zones[state->zones_count++] = zone;
+            state->mode = MODE_CLOCK;
+        } else if (strcmp(argv[i], "--suspend=count") == 0) {
+            state->suspend = SUSPEND_COUNT;
+        } else if (strcmp(argv[i], "--suspend=pause") == 0) {
+            state->suspend = SUSPEND_PAUSE;
+        } else if (strcmp(argv[i], "--clock") == 0) {
+            state->clock = parse_clock_config(arg_value(argc, argv, &i, "real, fixed:DT, replay:FILE or record:FILE"));
+        } else if (strcmp(argv[i], "--simulate") == 0) {
+            state->simulate = parse_time(arg_value(argc, argv, &i, "a duration like 2h"));
+        } else if (strcmp(argv[i], "--bench-frames") == 0) {
+            state->bench_frames = parse_time(arg_value(argc, argv, &i, "a duration like 30s"));
+        } else if (strcmp(argv[i], "--hog-cpu") == 0) {
+            state->hog_cpu = parse_int("--hog-cpu", arg_value(argc, argv, &i, "a number of threads"));
+        } else if (strcmp(argv[i], "--hog-mem") == 0) {
+            state->hog_memory = parse_int("--hog-mem", arg_value(argc, argv, &i, "a number of threads"));
+        } else if (strcmp(argv[i], "--gpu-queue") == 0) {
+            state->gpu_queue = parse_int("--gpu-queue", arg_value(argc, argv, &i, "a number of frames"));
+            if (state->gpu_queue < 1 || state->gpu_queue > GPU_QUEUE_MAX) {
+                fprintf(stderr, "`%d` is out of range, --gpu-queue must be between 1 and %d\n", state->gpu_queue, GPU_QUEUE_MAX);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            state->trace = arg_value(argc, argv, &i, "a file path");
+        } else if (strcmp(argv[i], "--metrics") == 0) {
+            state->metrics = arg_value(argc, argv, &i, "a file path like /var/lib/node_exporter/timer.prom");
+        } else if (strcmp(argv[i], "--metrics-interval") == 0) {
+            state->metrics_interval = parse_time(arg_value(argc, argv, &i, "a duration like 15s"));
+        } else if (strcmp(argv[i], "--governor") == 0) {
+            state->governor = 1;
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            state->latency = 1;
+        } else if (strcmp(argv[i], "--fps") == 0) {
+            state->fps = parse_int("--fps", arg_value(argc, argv, &i, "frames per second"));
+            if (state->fps < FPS_MIN || state->fps > FPS_MAX) {
+                fprintf(stderr, "`%d` is out of range, --fps must be between %d and %d\n", state->fps, FPS_MIN, FPS_MAX);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--power-supply") == 0) {
+            state->power_supply = arg_value(argc, argv, &i, "a directory like /sys/class/power_supply");
+        } else if (strcmp(argv[i], "--bench-power") == 0) {
+            state->bench_power = parse_time(arg_value(argc, argv, &i, "a duration like 10s"));
+        } else if (strcmp(argv[i], "--commands") == 0) {
+            state->commands = 1;
+        } else if (strcmp(argv[i], "--xcb") == 0) {
+            state->xcb = 1;
+        } else if (strcmp(argv[i], "--check-alloc") == 0) {
+            state->check_alloc = parse_int("--check-alloc", arg_value(argc, argv, &i, "a number of frames"));
+        } else if (strcmp(argv[i], "--sched") == 0) {
+            parse_rt_sched(&state->rt, arg_value(argc, argv, &i, "fifo:PRIO or rr:PRIO"));
+        } else if (strcmp(argv[i], "--cpu") == 0) {
+            parse_rt_cpus(&state->rt, arg_value(argc, argv, &i, "a CPU list like 2 or 0,2-3"));
+        } else if (strcmp(argv[i], "--mlock") == 0) {
+            state->rt.mlock = 1;
+        } else if (strcmp(argv[i], "until") == 0) {
+            state->until_ns = parse_deadline(arg_value(argc, argv, &i, "a wall time like 17:30 or 2025-06-01T17:30"));
+            state->mode = MODE_COUNTDOWN;
+            state->displayed_time = (double) (state->until_ns - clock_ns(CLOCK_REALTIME)) / 1e9;
         } else if (strcmp(argv[i], "clock") == 0) {
             state->mode = MODE_CLOCK;
         } else {
@@ -108,42 +352,57 @@ void state_update(State *state, float dt) {
                 break;
 
             case MODE_COUNTDOWN:
+                if (state->until_ns != 0) {
+                    // Wall-time deadlines are re-derived from the anchored clock, not accumulated
+                    if (!wall_clock.initialized) wall_clock_init(state->zones, state->zones_count);
+                    state->displayed_time = (double) (state->until_ns - wall_clock_now_ns()) / 1e9;
+                }
                 if (state->displayed_time > 1e-6f) {
-                    state->displayed_time -= dt;
+                    if (state->until_ns == 0) state->displayed_time -= dt;
                 } else {
                     state->displayed_time = 0.0f;
                     if (state->exit_after_countdown) {
-                        exit(0);
+                        state->quit = 1;
                     }
                 }
                 break;
 
             case MODE_CLOCK: {
-                float prev_time = state->displayed_time;
-                time_t t = time(NULL);
-                struct tm *tm = localtime(&t);
-
-                if (!tm) {
-                    fprintf(stderr, "localtime() failed\n");
-                    return;
-                }
-
-                state->displayed_time = tm->tm_sec + tm->tm_min * 60.0f + tm->tm_hour * 3600.0f;
-
-                // If time didn't advance (same second), keep continuity for animation
-                if (state->displayed_time <= prev_time) {
-                    // same seconds keep previous count and add subsecond resolution for penger
-                    if (floorf(prev_time) == floorf(prev_time + dt)) {
-                        state->displayed_time = prev_time + dt;
-                    } else {
-                        state->displayed_time = prev_time;
-                    }
+                if (!wall_clock.initialized) wall_clock_init(state->zones, state->zones_count);
+                int64_t now_ns = wall_clock_now_ns();
+                for (size_t i = 0; i < wall_clock.zones_count; ++i) {
+                    state->zone_times[i] = wall_clock_seconds_of_day(i, now_ns);
                 }
+                state->displayed_time = state->zone_times[0];
             } break;
         }
     }
 }
 
+// Applies time the machine spent suspended as one jump instead of a huge dt
+void state_skip(State *state, float seconds) {
+    if (state->paused) return;
+    switch (state->mode) {
+        case MODE_ASCENDING:
+            state->displayed_time += seconds;
+            break;
+        case MODE_COUNTDOWN:
+            // wall-time deadlines and the clock are re-derived on the next update anyway
+            if (state->until_ns == 0) state->displayed_time = fmax(state->displayed_time - seconds, 0.0);
+            break;
+        case MODE_CLOCK:
+            break;
+    }
+}
+
+// How many times are shown side by side: one per time zone in clock mode
+size_t state_times_count(const State *state) {
+    return state->mode == MODE_CLOCK && state->zones_count > 1 ? state->zones_count : 1;
+}
+
+float state_time_at(const State *state, size_t i) {
+    return state_times_count(state) > 1 ? state->zone_times[i] : state->displayed_time;
+}
 
 void initial_pen(int w, int h, int *pen_x, int *pen_y, float user_scale, float *fit_scale) {
     float text_aspect_ratio = (float)TEXT_WIDTH / (float)TEXT_HEIGHT;
@@ -0,0 +1,231 @@
+// Texture manager. Images are packed into atlas pages with a simple shelf
+// packer, so any number of sprites costs one texture unit per page instead of
+// one per image, and consecutive draws from the same page need no rebinding.
+// Limits come from the driver: the page size from GL_MAX_TEXTURE_SIZE and the
+// page count from GL_MAX_TEXTURE_IMAGE_UNITS (the fragment shader is the only
+// stage that samples). The GPU memory of every page is kept for the report.
+//
+// Usage: textures_add every image, then textures_build once. Pages use
+// immutable storage, so images can be replaced later (textures_update, e.g. a
+// hot-reloaded skin) but not added.
+
+#define TEXTURE_IMAGES_CAP 64
+#define TEXTURE_PAGES_CAP 8
+#define TEXTURE_PADDING 2 // transparent texels between images, linear filtering reads one over the edge
+
+typedef struct {
+    const uint32_t *data; // pixels for the initial upload
+    size_t page;
+    int x, y, w, h;       // position in the page
+} Texture_Image;
+
+typedef struct {
+    GLuint texture;
+    GLint unit;
+    int width, height;
+    size_t bytes;
+    size_t image_bytes; // the part actually covered by images
+    size_t images_count;
+} Texture_Page;
+
+typedef struct {
+    GLint max_size;
+    GLint max_units;
+    bool storage; // immutable texture storage
+    Texture_Image images[TEXTURE_IMAGES_CAP];
+    size_t images_count;
+    Texture_Page pages[TEXTURE_PAGES_CAP];
+    size_t pages_count;
+    size_t bytes;
+} Textures;
+
+static Textures textures = {0};
+
+// Returns the image id, or -1 when there is no room for another image
+int textures_add(const uint32_t *data, size_t width, size_t height) {
+    if (textures.images_count >= TEXTURE_IMAGES_CAP) return -1;
+    textures.images[textures.images_count] = (Texture_Image) {
+        .data = data,
+        .w = (int) width,
+        .h = (int) height,
+    };
+    return (int) textures.images_count++;
+}
+
+// Pixels go through a pixel unpack buffer. It is freshly allocated and mapped
+// unsynchronized, so the memcpy into it never waits for the GPU, and
+// glTexSubImage2D only queues the transfer into the texture. Without
+// glMapBufferRange (GL < 3.0), or when the unmap reports the contents lost,
+// glBufferData copies the pixels synchronously instead.
+static void textures_upload(const Texture_Image *image, const uint32_t *data) {
+    const GLsizeiptr size = (GLsizeiptr) image->w*image->h*sizeof(*data);
+    GLuint pbo;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    void *mapped = NULL;
+    if (glMapBufferRange) {
+        mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+    if (mapped) {
+        memcpy(mapped, data, (size_t) size);
+        if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) mapped = NULL;
+    }
+    if (!mapped) glBufferData(GL_PIXEL_UNPACK_BUFFER, size, data, GL_STREAM_DRAW);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, image->x, image->y, image->w, image->h, GL_RGBA, GL_UNSIGNED_BYTE, (const void*) 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    // the driver keeps the buffer alive until the transfer is done
+    glDeleteBuffers(1, &pbo);
+}
+
+// Shelf packing in insertion order: images go left to right, a new shelf
+// starts when the row is full and a new page when the shelves are
+static bool textures_pack(void) {
+    size_t pages_cap = TEXTURE_PAGES_CAP;
+    if ((size_t) textures.max_units < pages_cap) pages_cap = (size_t) textures.max_units;
+
+    int x = 0, y = 0, shelf_height = 0;
+    textures.pages_count = 0;
+    for (size_t i = 0; i < textures.images_count; ++i) {
+        Texture_Image *image = &textures.images[i];
+        if (image->w > textures.max_size || image->h > textures.max_size) {
+            fprintf(stderr, "ERROR: %dx%d image is larger than the %dx%d texture limit\n",
+                    image->w, image->h, textures.max_size, textures.max_size);
+            return false;
+        }
+        if (x + image->w > textures.max_size) {
+            x = 0;
+            y += shelf_height;
+            shelf_height = 0;
+        }
+        if (textures.pages_count == 0 || y + image->h > textures.max_size) {
+            if (textures.pages_count >= pages_cap) {
+                fprintf(stderr, "ERROR: images need more than %zu texture pages\n", pages_cap);
+                return false;
+            }
+            textures.pages[textures.pages_count] = (Texture_Page) {.unit = (GLint) textures.pages_count};
+            textures.pages_count++;
+            x = y = shelf_height = 0;
+        }
+
+        Texture_Page *page = &textures.pages[textures.pages_count - 1];
+        image->page = textures.pages_count - 1;
+        image->x = x;
+        image->y = y;
+        if (x + image->w > page->width) page->width = x + image->w;
+        if (y + image->h > page->height) page->height = y + image->h;
+        page->image_bytes += (size_t) image->w*image->h*sizeof(uint32_t);
+        page->images_count++;
+        x += image->w + TEXTURE_PADDING;
+        if (image->h + TEXTURE_PADDING > shelf_height) shelf_height = image->h + TEXTURE_PADDING;
+    }
+    return true;
+}
+
+// Storage contents start out undefined, the padding has to be transparent
+static void textures_clear_page(const Texture_Page *page) {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, page->texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+        glViewport(0, 0, page->width, page->height);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+    } else {
+        fprintf(stderr, "WARNING: could not clear texture page, sprite edges may pick up garbage\n");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// glXGetProcAddress hands out a stub for any gl* name, so a non-NULL
+// glTexStorage2D says nothing; the version or the extension list does
+static bool textures_have_storage(void) {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 2)) return true;
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char *name = (const char *) glGetStringi(GL_EXTENSIONS, (GLuint) i);
+        if (name && strcmp(name, "GL_ARB_texture_storage") == 0) return true;
+    }
+    return false;
+}
+
+bool textures_build(void) {
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &textures.max_size);
+    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &textures.max_units);
+    textures.storage = textures_have_storage();
+    if (!textures_pack()) return false;
+
+    textures.bytes = 0;
+    for (size_t i = 0; i < textures.pages_count; ++i) {
+        Texture_Page *page = &textures.pages[i];
+        gl_cache_active_texture(GL_TEXTURE0 + page->unit);
+        glGenTextures(1, &page->texture);
+        glBindTexture(GL_TEXTURE_2D, page->texture);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+        if (textures.storage) {
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, page->width, page->height);
+        } else {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, page->width, page->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+        page->bytes = (size_t) page->width*page->height*sizeof(uint32_t);
+        textures.bytes += page->bytes;
+        textures_clear_page(page);
+    }
+
+    for (size_t i = 0; i < textures.images_count; ++i) {
+        Texture_Image *image = &textures.images[i];
+        gl_cache_active_texture(GL_TEXTURE0 + textures.pages[image->page].unit);
+        textures_upload(image, image->data);
+    }
+    return true;
+}
+
+// Replaces the pixels of an image, the size stays the one it was added with
+void textures_update(int image, const uint32_t *data) {
+    const Texture_Image *it = &textures.images[image];
+    gl_cache_active_texture(GL_TEXTURE0 + textures.pages[it->page].unit);
+    glBindTexture(GL_TEXTURE_2D, textures.pages[it->page].texture);
+    textures_upload(it, data);
+}
+
+GLint textures_unit(int image) {
+    return textures.pages[textures.images[image].page].unit;
+}
+
+// Moves a rectangle inside the image to page coordinates and returns the page size
+void textures_locate(int image, RGFW_rect *rect, int *page_width, int *page_height) {
+    const Texture_Image *it = &textures.images[image];
+    const Texture_Page *page = &textures.pages[it->page];
+    rect->x += it->x;
+    rect->y += it->y;
+    *page_width = page->width;
+    *page_height = page->height;
+}
+
+void textures_report(FILE *out) {
+    fprintf(out, "textures: %zu images in %zu pages (%d units, %dx%d max), %.1f KiB of GPU memory\n",
+            textures.images_count, textures.pages_count, textures.max_units, textures.max_size, textures.max_size,
+            textures.bytes / 1024.0);
+    for (size_t i = 0; i < textures.pages_count; ++i) {
+        const Texture_Page *page = &textures.pages[i];
+        fprintf(out, "  page %zu on unit %d: %dx%d, %zu images, %.1f KiB (%.0f%% used)\n", i, page->unit,
+                page->width, page->height, page->images_count, page->bytes / 1024.0,
+                page->bytes ? 100.0 * page->image_bytes / page->bytes : 0.0);
+    }
+}
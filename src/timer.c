@@ -8,8 +8,31 @@
 #include "digits.h"
 #include "penger_walk_sheet.h"
 
+#include "wallclock.c"
+#include "frameclock.c"
+#include "rt.c"
 #include "state.c"
 #include "glextloader.c"
+#include "glcache.c"
+#include "checkpoint.c"
+#include "expiry.c"
+#include "tty.c"
+#include "emit.c"
+#include "simulate.c"
+#include "refresh.c"
+#include "xcbwin.c"
+#include "xbatch.c"
+#include "reactor.c"
+#include "power.c"
+#include "framestats.c"
+#include "hog.c"
+#include "alloccheck.c"
+#include "latency.c"
+#include "gpuqueue.c"
+#include "textures.c"
+#include "trace.c"
+#include "metrics.c"
+#include "governor.c"
 
 const char *vert_shader_source =
     "#version 330\n"
@@ -93,33 +116,6 @@ bool link_program(GLuint vert_shader, GLuint frag_shader, GLuint *program) {
     return true;
 }
 
-GLint load_image_data_as_gl_texture(const uint32_t *data, size_t width, size_t height) {
-    static GLint texture_units_count = 0;
-    if (texture_units_count >= GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS) return -1;
-
-    GLint texture_unit = texture_units_count++;
-    GLuint texture;
-    glActiveTexture(GL_TEXTURE0 + texture_unit);
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-    glTexImage2D(GL_TEXTURE_2D,
-                0,
-                GL_RGBA,
-                width,
-                height,
-                0,
-                GL_RGBA,
-                GL_UNSIGNED_BYTE,
-                data);
-    return texture_unit;
-}
-
 GLint tex_uni;
 GLint dst_rect_uni;
 GLint scr_size_uni;
@@ -128,18 +124,29 @@ GLint tex_size_uni;
 GLint color_mod_uni;
 
 void set_texture_color_mod(GLfloat r, GLfloat g, GLfloat b) {
-    glUniform4f(color_mod_uni, r, g, b, 1);
+    gl_cache_uniform4f(color_mod_uni, r, g, b, 1);
+}
+
+void set_paused_color_mod(bool paused) {
+    if (paused) {
+        set_texture_color_mod(PAUSE_COLOR_R/255.0f, PAUSE_COLOR_G/255.0f, PAUSE_COLOR_B/255.0f);
+    } else {
+        set_texture_color_mod(MAIN_COLOR_R/255.0f, MAIN_COLOR_G/255.0f, MAIN_COLOR_B/255.0f);
+    }
 }
 
-void texture_copy(GLint texture_unit, int tex_width, int tex_height, RGFW_rect src_rect, RGFW_rect dst_rect) {
-    glUniform1i(tex_uni, texture_unit);
-    glUniform4f(dst_rect_uni, dst_rect.x, dst_rect.y, dst_rect.w, dst_rect.h);
-    glUniform4f(src_rect_uni, src_rect.x, src_rect.y, src_rect.w, src_rect.h);
-    glUniform2f(tex_size_uni, tex_width, tex_height);
+void texture_copy(int image, RGFW_rect src_rect, RGFW_rect dst_rect) {
+    int tex_width, tex_height;
+    textures_locate(image, &src_rect, &tex_width, &tex_height);
+    gl_cache_uniform1i(tex_uni, textures_unit(image));
+    gl_cache_uniform4f(dst_rect_uni, dst_rect.x, dst_rect.y, dst_rect.w, dst_rect.h);
+    gl_cache_uniform4f(src_rect_uni, src_rect.x, src_rect.y, src_rect.w, src_rect.h);
+    gl_cache_uniform2f(tex_size_uni, tex_width, tex_height);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
 
-void render_digit_at(GLint digits_tex_unit, size_t digit_index, size_t wiggle_index, int *pen_x, int *pen_y, float user_scale, float fit_scale){
+void render_digit_at(int digits_image, size_t digit_index, size_t wiggle_index, int *pen_x, int *pen_y, float user_scale, float fit_scale){
+    Trace_Zone zone = trace_begin("render_digit");
     const int effective_digit_width = (int) floorf((float) CHAR_WIDTH * user_scale * fit_scale);
     const int effective_digit_height = (int) floorf((float) CHAR_HEIGHT * user_scale * fit_scale);
 
@@ -157,12 +164,14 @@ void render_digit_at(GLint digits_tex_unit, size_t digit_index, size_t wiggle_in
         effective_digit_height
     };
 
-    texture_copy(digits_tex_unit, digits_width, digits_height, src_rect, dst_rect);
+    texture_copy(digits_image, src_rect, dst_rect);
 
     *pen_x += effective_digit_width;
+    trace_end(zone);
 }
 
-void render_penger_at(GLint penger_tex_unit, int window_width, int window_height, float time, int flipped) {
+void render_penger_at(int penger_image, int window_width, int window_height, float time, int flipped) {
+    Trace_Zone zone = trace_begin("render_penger");
     int sps = PENGER_STEPS_PER_SECOND;
     int step = (int) (time * sps)%(60*sps); // step index [0, 60*sps-1]
 
@@ -189,14 +198,68 @@ void render_penger_at(GLint penger_tex_unit, int window_width, int window_height
         src_rect.x += src_rect.w;
         src_rect.w *= -1;
     }
-    texture_copy(penger_tex_unit, penger_width, penger_height, src_rect, dst_rect);
+    texture_copy(penger_image, src_rect, dst_rect);
+    trace_end(zone);
+}
+
+void render_time_at(int digits_image, float time, size_t wiggle_index, int x, int width, int height, float user_scale) {
+    const size_t t = (size_t) floorf(fmaxf(time, 0.0f));
+
+    int pen_x, pen_y;
+    float fit_scale = 1.0f;
+    initial_pen(width, height, &pen_x, &pen_y, user_scale, &fit_scale);
+    pen_x += x;
+
+    const size_t hours = t / 60 / 60;
+    render_digit_at(digits_image, hours / 10,   wiggle_index      % WIGGLE_COUNT, &pen_x, &pen_y, user_scale, fit_scale);
+    render_digit_at(digits_image, hours % 10,  (wiggle_index + 1) % WIGGLE_COUNT, &pen_x, &pen_y, user_scale, fit_scale);
+    render_digit_at(digits_image, COLON_INDEX,  wiggle_index      % WIGGLE_COUNT, &pen_x, &pen_y, user_scale, fit_scale);
+
+    const size_t minutes = t / 60 % 60;
+    render_digit_at(digits_image, minutes / 10, (wiggle_index + 2) % WIGGLE_COUNT, &pen_x, &pen_y, user_scale, fit_scale);
+    render_digit_at(digits_image, minutes % 10, (wiggle_index + 3) % WIGGLE_COUNT, &pen_x, &pen_y, user_scale, fit_scale);
+    render_digit_at(digits_image, COLON_INDEX,  (wiggle_index + 1) % WIGGLE_COUNT, &pen_x, &pen_y, user_scale, fit_scale);
+
+    const size_t seconds = t % 60;
+    render_digit_at(digits_image, seconds / 10, (wiggle_index + 4) % WIGGLE_COUNT, &pen_x, &pen_y, user_scale, fit_scale);
+    render_digit_at(digits_image, seconds % 10, (wiggle_index + 5) % WIGGLE_COUNT, &pen_x, &pen_y, user_scale, fit_scale);
 }
 
 
 int main(int argc, char **argv) {
     State state = {0};
     parse_state_from_args(&state, argc, argv);
-    
+    if (state.state_file) {
+        if (!checkpoint_open(state.state_file, argc, argv)) return 1;
+        checkpoint_restore(&state);
+    }
+    if (state.bench_expiry) return expiry_bench(&state, state.bench_expiry);
+    if (state.simulate > 0.0f) return simulate_main(&state);
+    if (!state.tty) reactor_block_signals();
+    if (state.exit_after_countdown || state.on_expire_cmd || state.on_expire_fifo || state.on_expire_pid) {
+        if (!expiry_begin(&state)) return 1;
+    }
+    if (state.tty) {
+        if (state.emit != EMIT_NONE) {
+            fprintf(stderr, "ERROR: --tty and --emit both need stdout\n");
+            return 1;
+        }
+        int result = tty_main(&state);
+        if (state.quit) expiry_wait();
+        expiry_end();
+        return result;
+    }
+    emit_begin(state.emit);
+    if (state.check_alloc > 0 && !alloc_check_begin((size_t) state.check_alloc)) return 1;
+    if (state.commands && state.emit != EMIT_NONE) {
+        fprintf(stderr, "ERROR: --commands and --emit cannot be combined, a status bar owns both ends of the pipe\n");
+        return 1;
+    }
+    if (state.rt.mlock && state.hog_memory > 0) {
+        fprintf(stderr, "ERROR: --mlock and --hog-mem cannot be combined, the locked hog buffers would skew the contention\n");
+        return 1;
+    }
+
     RGFW_setGLHint(RGFW_glProfile, RGFW_glCore);
     RGFW_setGLHint(RGFW_glMajor, 3);
     RGFW_setGLHint(RGFW_glMinor, 3);
@@ -207,9 +270,18 @@ int main(int argc, char **argv) {
     // Create a new RGFW window
     RGFW_window* win = RGFW_createWindow("timer", win_rect, (u64)0);
 
-    printf("Window pointer address: %p\n", (void*)win);
+    // stdout belongs to the status stream when --emit is on
+    if (state.emit == EMIT_NONE) printf("Window pointer address: %p\n", (void*)win);
+    // xcb_window_begin warns when it has to stay on Xlib
+    if (state.xcb && !xcb_window_begin(win)) state.xcb = 0;
+    x_batch_begin(win, "timer");
     load_gl_extensions();
 
+    // load the images as texture, the transfers overlap with shader compilation
+    int digits_image = textures_add(digits_data, digits_width, digits_height);
+    int penger_image = textures_add(penger_data, penger_width, penger_height);
+    if (!textures_build()) return 1;
+
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
@@ -219,7 +291,7 @@ int main(int argc, char **argv) {
     if (!compile_shader_source(frag_shader_source, GL_FRAGMENT_SHADER, &frag_shader)) return 1;
     GLuint program;
     if (!link_program(vert_shader, frag_shader, &program)) return 1;
-    glUseProgram(program);
+    gl_cache_use_program(program);
 
     tex_uni       = glGetUniformLocation(program, "tex");
     dst_rect_uni  = glGetUniformLocation(program, "dst_rect");
@@ -228,14 +300,10 @@ int main(int argc, char **argv) {
     tex_size_uni  = glGetUniformLocation(program, "tex_size");
     color_mod_uni = glGetUniformLocation(program, "color_mod");
 
-    glUniform4f(dst_rect_uni, 0, 0, 500, 500);
-    glUniform2f(scr_size_uni, win_rect.w, win_rect.h);
-    glUniform4f(src_rect_uni, 0, 0, CHAR_WIDTH, CHAR_HEIGHT);
-    glUniform2f(tex_size_uni, digits_width, digits_height);
-
-    // load the images as texture
-    GLint digits_tex_unit = load_image_data_as_gl_texture(digits_data, digits_width, digits_height);
-    GLint penger_tex_unit = load_image_data_as_gl_texture(penger_data, penger_width, penger_height);
+    gl_cache_uniform4f(dst_rect_uni, 0, 0, 500, 500);
+    gl_cache_uniform2f(scr_size_uni, win_rect.w, win_rect.h);
+    gl_cache_uniform4f(src_rect_uni, 0, 0, CHAR_WIDTH, CHAR_HEIGHT);
+    gl_cache_uniform2f(tex_size_uni, digits_width, digits_height);
 
     set_texture_color_mod(MAIN_COLOR_R/255.0f, MAIN_COLOR_G/255.0f, MAIN_COLOR_B/255.0f);
     if (state.paused) {
@@ -248,17 +316,52 @@ int main(int argc, char **argv) {
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
 
-    uint64_t last_time = RGFW_getTimerValue();
+    if (!frame_clock_init(state.suspend, state.clock)) return 1;
+    refresh_begin(win, state.fps);
+    if (!reactor_begin(win, refresh_interval_ns(), state.commands)) return 1;
+    power_begin(win, state.power_supply, state.bench_power);
+    latency_begin(state.latency);
+    gpu_queue_begin(state.gpu_queue);
+    trace_begin_session(state.trace);
+    // before rt_begin, so the writer thread does not inherit a realtime priority
+    metrics_begin(state.metrics, state.metrics_interval);
+    governor_begin(state.governor);
+    int64_t bench_end_ns = 0;
+    if (state.bench_frames > 0.0f) {
+        hogs_start(state.hog_cpu, state.hog_memory);
+        bench_end_ns = clock_ns(CLOCK_MONOTONIC) + (int64_t) ((double) state.bench_frames * 1e9);
+    }
+    if (rt_requested(&state.rt)) {
+        // after the hogs are started, so they do not inherit the priority
+        rt_begin(&state.rt);
+        if (state.rt.mlock) {
+            rt_prefault(digits_data, sizeof(digits_data));
+            rt_prefault(penger_data, sizeof(penger_data));
+        }
+    }
     // Main event loop
-    while (!RGFW_window_shouldClose(win)) {
-        uint64_t now = RGFW_getTimerValue();
-        float dt = (float)(now - last_time)/RGFW_getTimerFreq();
-        last_time = now;
-        while (RGFW_window_checkEvent(win)) {
+    while (!RGFW_window_shouldClose(win) && !state.quit) {
+        float suspended;
+        float dt = frame_clock_tick(&suspended);
+        if (suspended > 0.0f) state_skip(&state, suspended);
+        refresh_update(win, frame_clock.frame_start_ns);
+        if (power_update(&state, frame_clock.frame_start_ns)) break;
+        frame_stats_begin_frame(frame_clock.frame_start_ns, power_frame_interval_ns());
+        governor_frame_begin(frame_clock.frame_start_ns, power_frame_interval_ns(), suspended > 0.0f);
+        x_batch_begin_frame();
+        if (bench_end_ns != 0 && frame_clock.frame_start_ns >= bench_end_ns) break;
+        // Event handlers issue GL calls too, and input read after the wait is fresher
+        gpu_queue_wait();
+        Trace_Zone events_zone = trace_begin("events");
+        while (window_check_event(win)) {
+            metrics_event();
+            power_event(win->event.type);
+            refresh_event(win->event.type);
+            if (win->event.type == RGFW_keyPressed) latency_key_drained();
             switch (win->event.type) {
                 case RGFW_windowResized: {
                     glViewport(0, 0, win->r.w, win->r.h);
-                    glUniform2f(scr_size_uni, win->r.w, win->r.h);
+                    gl_cache_uniform2f(scr_size_uni, win->r.w, win->r.h);
                 } break;
                 case RGFW_keyPressed: {
                     switch (win->event.key) {
@@ -292,13 +395,11 @@ int main(int argc, char **argv) {
                             }
                         } break;
                         
+                        case RGFW_F9: {
+                            gl_trace_report(stderr);
+                        } break;
                         case RGFW_F11: {
-                            RGFW_windowFlags windowFlags = win->_flags;
-                            if (windowFlags & RGFW_windowFullscreen) {
-                                RGFW_window_setFlags(win, windowFlags & (~RGFW_windowFullscreen));
-                            } else {
-                                RGFW_window_setFlags(win, windowFlags | RGFW_windowFullscreen);
-                            }
+                            x_batch_toggle_fullscreen();
                         } break;
                         }
                     } break;
@@ -313,55 +414,117 @@ int main(int argc, char **argv) {
                 } break;
             }
         }
+        trace_end(events_zone);
+        alloc_check_mark(ALLOC_PHASE_EVENTS);
 
         // RENDER BEGIN ///////////////////////////////////
+        governor_render_begin(win->r.w, win->r.h);
         glClearColor(BACKGROUND_COLOR_R/255.0f, BACKGROUND_COLOR_G/255.0f, BACKGROUND_COLOR_B/255.0f, 1);
         glClear(GL_COLOR_BUFFER_BIT);
         {
             const size_t t = (size_t) floorf(fmaxf(state.displayed_time, 0.0f));
 
-            render_penger_at(penger_tex_unit, win->r.w, win->r.h, state.displayed_time, state.mode==MODE_COUNTDOWN);
+            if (governor_draw_penger()) {
+                render_penger_at(penger_image, win->r.w, win->r.h, state.displayed_time, state.mode==MODE_COUNTDOWN);
+            }
 
-            int pen_x, pen_y;
-            float fit_scale = 1.0f;
-            initial_pen(win->r.w, win->r.h, &pen_x, &pen_y, state.user_scale, &fit_scale);
+            // Several time zones share the window, one column each
+            const size_t clocks = state_times_count(&state);
+            const int column_width = win->r.w / (int) clocks;
+            const size_t wiggle_index = governor_wiggle_index(state.wiggle_index);
+            for (size_t i = 0; i < clocks; ++i) {
+                render_time_at(digits_image, state_time_at(&state, i), wiggle_index, column_width * (int) i, column_width, win->r.h, state.user_scale);
+            }
+            governor_render_end(win->r.w, win->r.h);
 
             const size_t hours = t / 60 / 60;
-            render_digit_at(digits_tex_unit, hours / 10,   state.wiggle_index      % WIGGLE_COUNT, &pen_x, &pen_y, state.user_scale, fit_scale);
-            render_digit_at(digits_tex_unit, hours % 10,  (state.wiggle_index + 1) % WIGGLE_COUNT, &pen_x, &pen_y, state.user_scale, fit_scale);
-            render_digit_at(digits_tex_unit, COLON_INDEX,  state.wiggle_index      % WIGGLE_COUNT, &pen_x, &pen_y, state.user_scale, fit_scale);
-
             const size_t minutes = t / 60 % 60;
-            render_digit_at(digits_tex_unit, minutes / 10, (state.wiggle_index + 2) % WIGGLE_COUNT, &pen_x, &pen_y, state.user_scale, fit_scale);
-            render_digit_at(digits_tex_unit, minutes % 10, (state.wiggle_index + 3) % WIGGLE_COUNT, &pen_x, &pen_y, state.user_scale, fit_scale);
-            render_digit_at(digits_tex_unit, COLON_INDEX,  (state.wiggle_index + 1) % WIGGLE_COUNT, &pen_x, &pen_y, state.user_scale, fit_scale);
-
             const size_t seconds = t % 60;
-            render_digit_at(digits_tex_unit, seconds / 10, (state.wiggle_index + 4) % WIGGLE_COUNT, &pen_x, &pen_y, state.user_scale, fit_scale);
-            render_digit_at(digits_tex_unit, seconds % 10, (state.wiggle_index + 5) % WIGGLE_COUNT, &pen_x, &pen_y, state.user_scale, fit_scale);
-
             char title[TITLE_CAP];
             snprintf(title, sizeof(title), "%02zu:%02zu:%02zu - timer", hours, minutes, seconds);
+            Trace_Zone title_zone = trace_begin("title");
             if (strcmp(state.prev_title, title) != 0) {
-                RGFW_window_setName(win, title);
+                x_batch_set_title(title);
+                memcpy(state.prev_title, title, TITLE_CAP);
             }
-            memcpy(title, state.prev_title, TITLE_CAP);
-
+            x_batch_end_frame((long long) t);
+            trace_end(title_zone);
         }
+        alloc_check_mark(ALLOC_PHASE_RENDER);
 
+        Trace_Zone swap_zone = trace_begin("swap");
+        governor_swap_begin();
         RGFW_window_swapBuffers(win);
+        governor_swap_end();
+        trace_end(swap_zone);
+        gpu_queue_push();
+        gl_trace_end_frame();
+        latency_frame_presented();
+        alloc_check_mark(ALLOC_PHASE_SWAP);
 
         // update state
+        Trace_Zone state_zone = trace_begin("state_update");
         state_update(&state, dt);
+        trace_end(state_zone);
+        expiry_update(&state);
+        checkpoint_update(&state);
+        emit_update(&state);
+        metrics_update(&state);
+        alloc_check_mark(ALLOC_PHASE_STATE);
+        governor_frame_end(state.wiggle_index);
+
+        Trace_Zone sleep_zone = trace_begin("sleep");
+        unsigned commands = reactor_wait();
+        trace_end(sleep_zone);
+        if (commands & REACTOR_FLUSH_TRACE) trace_flush();
+        if (commands & REACTOR_RESET) {
+            parse_state_from_args(&state, argc, argv);
+            set_paused_color_mod(state.paused);
+        }
+        if (commands & (REACTOR_TOGGLE_PAUSE | REACTOR_PAUSE | REACTOR_RESUME)) {
+            if (commands & REACTOR_TOGGLE_PAUSE) state.paused = !state.paused;
+            if (commands & REACTOR_PAUSE) state.paused = 1;
+            if (commands & REACTOR_RESUME) state.paused = 0;
+            set_paused_color_mod(state.paused);
+        }
+        if (commands & REACTOR_QUIT) RGFW_window_setShouldClose(win, RGFW_TRUE);
+        if (alloc_check_end_frame()) break;
+    }
 
-        now = RGFW_getTimerValue();
-        uint64_t frame_time = ((now - last_time)*1000.0f)/RGFW_getTimerFreq();
-        uint64_t frame_cap = 1000/FPS;
-        if (frame_time < frame_cap) RGFW_sleep(frame_cap - frame_time);
+    if (bench_end_ns != 0) {
+        hogs_stop();
+        printf("frame bench: %.1fs with %d CPU hogs and %d memory hogs\n", state.bench_frames, state.hog_cpu, state.hog_memory);
+        frame_stats_report(stdout);
+        x_batch_report(stdout);
+        gpu_queue_report(stdout);
+        textures_report(stdout);
+        gl_cache_report(stdout);
+        governor_report(stdout);
+        reactor_report(stdout);
+    }
+    if (state.bench_power > 0.0f) {
+        power_bench_report(stdout);
+        reactor_report(stdout);
     }
+    latency_report(stdout);
+    trace_flush();
+#ifdef GL_TRACE
+    gl_trace_report(stderr);
+#endif
+    rt_report(stdout);
+    int exit_code = alloc_check_report();
+
+    // Let a pending expiry run its hooks before going away
+    if (state.quit) expiry_wait();
+    expiry_end();
 
     // Clean up and close the window
+    metrics_end(&state);
+    refresh_end();
+    reactor_end();
+    frame_clock_end();
+    checkpoint_close();
     RGFW_window_close(win);
-    return 0;
+    return exit_code;
 }
 
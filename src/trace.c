@@ -0,0 +1,122 @@
+// Timeline capture (`--trace FILE`). Code marks zones with trace_begin and
+// trace_end; every thread records into its own ring buffer, written only by
+// that thread, so recording takes no lock and never blocks. The rings keep the
+// most recent TRACE_RING_CAP zones, a flight recorder of the last few seconds.
+// trace_flush snapshots them into Chrome trace-event JSON (open it in Perfetto
+// or chrome://tracing). It runs at exit and on demand: SIGRTMIN or the `trace`
+// command of `--commands`, since SIGUSR1 already toggles pause. The file is
+// written next to FILE and renamed over it, so a reader never sees half of it.
+
+#define TRACE_RING_CAP 16384 // power of two
+#define TRACE_THREADS_CAP 16
+
+typedef struct {
+    const char *name; // string literal
+    int64_t start_ns;
+    int64_t end_ns;
+} Trace_Event;
+
+typedef struct {
+    pid_t tid;
+    atomic_uint_fast64_t head; // events ever recorded, only the owner thread writes it
+    Trace_Event events[TRACE_RING_CAP];
+} Trace_Ring;
+
+typedef struct {
+    const char *path;
+    atomic_int active;
+    Trace_Ring *rings[TRACE_THREADS_CAP];
+    atomic_size_t rings_count;
+} Trace;
+
+typedef struct {
+    const char *name;
+    int64_t start_ns; // 0 when tracing is off
+} Trace_Zone;
+
+static Trace trace = {0};
+static _Thread_local Trace_Ring *trace_ring = NULL;
+
+// The first zone of a thread allocates its ring, after that recording is a
+// few stores. Returns NULL when the ring table is full.
+static Trace_Ring *trace_thread_ring(void) {
+    if (trace_ring) return trace_ring;
+    size_t index = atomic_fetch_add(&trace.rings_count, 1);
+    if (index >= TRACE_THREADS_CAP) {
+        atomic_store(&trace.rings_count, TRACE_THREADS_CAP);
+        return NULL;
+    }
+    Trace_Ring *ring = calloc(1, sizeof(*ring));
+    if (!ring) return NULL;
+    ring->tid = (pid_t) syscall(SYS_gettid);
+    trace.rings[index] = ring;
+    trace_ring = ring;
+    return ring;
+}
+
+void trace_begin_session(const char *path) {
+    if (!path) return;
+    trace.path = path;
+    atomic_store(&trace.active, 1);
+    // the calling thread is the render thread, give it its ring now and not in the first frame
+    trace_thread_ring();
+}
+
+Trace_Zone trace_begin(const char *name) {
+    if (!atomic_load_explicit(&trace.active, memory_order_relaxed)) return (Trace_Zone) {0};
+    return (Trace_Zone) {name, clock_ns(CLOCK_MONOTONIC)};
+}
+
+void trace_end(Trace_Zone zone) {
+    if (zone.start_ns == 0) return;
+    Trace_Ring *ring = trace_thread_ring();
+    if (!ring) return;
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    ring->events[head & (TRACE_RING_CAP - 1)] = (Trace_Event) {zone.name, zone.start_ns, clock_ns(CLOCK_MONOTONIC)};
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+// Copies whatever of the ring the owner has not overwritten meanwhile
+static void trace_write_ring(FILE *out, const Trace_Ring *ring, pid_t pid, bool *first) {
+    fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            *first ? "" : ",", (int) pid, (int) ring->tid, ring->tid == pid ? "render" : "worker");
+    *first = false;
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t begin = head > TRACE_RING_CAP ? head - TRACE_RING_CAP : 0;
+    for (uint64_t i = begin; i < head; ++i) {
+        Trace_Event event = ring->events[i & (TRACE_RING_CAP - 1)];
+        // the slot may have been reused while it was copied
+        if (atomic_load_explicit(&ring->head, memory_order_acquire) - i >= TRACE_RING_CAP) continue;
+        fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", event.name,
+                (int) pid, (int) ring->tid, event.start_ns / 1e3, (event.end_ns - event.start_ns) / 1e3);
+    }
+}
+
+void trace_flush(void) {
+    if (!atomic_load(&trace.active)) return;
+
+    char temp_path[PATH_MAX];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", trace.path);
+    FILE *out = fopen(temp_path, "w");
+    if (!out) {
+        fprintf(stderr, "WARNING: could not write trace `%s`: %s\n", temp_path, strerror(errno));
+        return;
+    }
+
+    const pid_t pid = getpid();
+    bool first = true;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    size_t rings_count = atomic_load(&trace.rings_count);
+    for (size_t i = 0; i < rings_count; ++i) {
+        if (trace.rings[i]) trace_write_ring(out, trace.rings[i], pid, &first);
+    }
+    fprintf(out, "\n]}\n");
+
+    if (fclose(out) != 0 || rename(temp_path, trace.path) < 0) {
+        fprintf(stderr, "WARNING: could not write trace `%s`: %s\n", trace.path, strerror(errno));
+        unlink(temp_path);
+        return;
+    }
+    fprintf(stderr, "INFO: trace written to %s\n", trace.path);
+}
@@ -0,0 +1,306 @@
+#include <poll.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+
+// Terminal backend for headless boxes. Draws the same HH:MM:SS layout as
+// render_digit_at with block glyphs. What is on the terminal is mirrored in
+// a shadow buffer and every update only sends the cells that changed, as
+// a single write(). Between updates the process sleeps in poll() until the
+// next second boundary or a key press.
+
+#define TTY_GLYPH_WIDTH 3
+#define TTY_GLYPH_HEIGHT 5
+#define TTY_PIXEL_WIDTH 2 // terminal cells are about twice as tall as wide
+#define TTY_GLYPH_GAP 2
+#define TTY_TEXT_WIDTH (CHARS_COUNT * TTY_GLYPH_WIDTH * TTY_PIXEL_WIDTH + (CHARS_COUNT - 1) * TTY_GLYPH_GAP)
+#define TTY_COLS_CAP 512
+#define TTY_ROWS_CAP 256
+#define TTY_OUT_CAP (64 * 1024)
+#define TTY_BLOCK "\xe2\x96\x88" // U+2588 FULL BLOCK
+
+typedef enum {
+    TTY_CELL_BLANK = 0,
+    TTY_CELL_MAIN,
+    TTY_CELL_PAUSE,
+} Tty_Cell;
+
+static const char *tty_glyphs[COLON_INDEX + 1][TTY_GLYPH_HEIGHT] = {
+    {"###", "# #", "# #", "# #", "###"},
+    {" # ", "## ", " # ", " # ", "###"},
+    {"###", "  #", "###", "#  ", "###"},
+    {"###", "  #", "###", "  #", "###"},
+    {"# #", "# #", "###", "  #", "  #"},
+    {"###", "#  ", "###", "  #", "###"},
+    {"###", "#  ", "###", "# #", "###"},
+    {"###", "  #", "  #", "  #", "  #"},
+    {"###", "# #", "###", "# #", "###"},
+    {"###", "# #", "###", "  #", "###"},
+    {"   ", " # ", "   ", " # ", "   "},
+};
+
+typedef struct {
+    int rows, cols;
+    Tty_Cell front[TTY_ROWS_CAP][TTY_COLS_CAP]; // what the terminal shows
+    Tty_Cell back[TTY_ROWS_CAP][TTY_COLS_CAP];  // what the next update should show
+
+    char out[TTY_OUT_CAP];
+    size_t out_size;
+    int cursor_row, cursor_col; // -1 when unknown
+    Tty_Cell pen;               // color currently selected on the terminal
+
+    struct termios saved_termios;
+    int termios_saved; // tcgetattr succeeded, saved_termios is worth restoring
+    int raw;           // alternate screen and hidden cursor
+    size_t bytes_written;
+} Tty;
+
+static Tty tty = {0};
+static volatile sig_atomic_t tty_resized = 0;
+static volatile sig_atomic_t tty_quit = 0;
+
+static void tty_flush(void) {
+    size_t written = 0;
+    while (written < tty.out_size) {
+        ssize_t n = write(STDOUT_FILENO, tty.out + written, tty.out_size - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += (size_t)n;
+    }
+    tty.bytes_written += written;
+    tty.out_size = 0;
+}
+
+// A full buffer is written out early rather than dropped, the front buffer
+// already counts the cells as sent
+static void tty_out(const char *data, size_t size) {
+    if (tty.out_size + size > TTY_OUT_CAP) tty_flush();
+    if (size > TTY_OUT_CAP) size = TTY_OUT_CAP;
+    memcpy(tty.out + tty.out_size, data, size);
+    tty.out_size += size;
+}
+
+static void tty_outf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    va_list retry;
+    va_copy(retry, args);
+    int n = vsnprintf(tty.out + tty.out_size, TTY_OUT_CAP - tty.out_size, fmt, args);
+    if (n > 0 && tty.out_size + (size_t)n >= TTY_OUT_CAP && tty.out_size > 0) {
+        tty_flush();
+        n = vsnprintf(tty.out, TTY_OUT_CAP, fmt, retry);
+    }
+    va_end(retry);
+    va_end(args);
+    if (n > 0) tty.out_size += (size_t)n < TTY_OUT_CAP ? (size_t)n : TTY_OUT_CAP - 1;
+}
+
+static void tty_restore(void) {
+    if (tty.raw) {
+        tty_outf("\x1b[0m\x1b[?25h\x1b[?1049l");
+        tty_flush();
+        tty.raw = 0;
+    }
+    if (tty.termios_saved) {
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &tty.saved_termios);
+        tty.termios_saved = 0;
+    }
+}
+
+static void tty_on_signal(int sig) {
+    if (sig == SIGWINCH) tty_resized = 1;
+    else tty_quit = 1;
+}
+
+static void tty_query_size(void) {
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) < 0 || ws.ws_row == 0 || ws.ws_col == 0) {
+        ws.ws_row = 24;
+        ws.ws_col = 80;
+    }
+    tty.rows = ws.ws_row < TTY_ROWS_CAP ? ws.ws_row : TTY_ROWS_CAP;
+    tty.cols = ws.ws_col < TTY_COLS_CAP ? ws.ws_col : TTY_COLS_CAP;
+
+    // The screen gets cleared, so the shadow buffer starts out blank as well
+    memset(tty.front, 0, sizeof(tty.front));
+    tty.cursor_row = -1;
+    tty.cursor_col = -1;
+    tty_outf("\x1b[2J");
+}
+
+static bool tty_begin(void) {
+    if (!isatty(STDOUT_FILENO)) {
+        fprintf(stderr, "ERROR: --tty needs stdout to be a terminal\n");
+        return false;
+    }
+    if (isatty(STDIN_FILENO)) {
+        if (tcgetattr(STDIN_FILENO, &tty.saved_termios) == 0) {
+            tty.termios_saved = 1;
+            struct termios raw = tty.saved_termios;
+            raw.c_lflag &= ~(ICANON | ECHO);
+            raw.c_cc[VMIN] = 0;
+            raw.c_cc[VTIME] = 0;
+            tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+        }
+    }
+    tty.raw = 1;
+    tty.pen = TTY_CELL_BLANK;
+    atexit(tty_restore);
+
+    struct sigaction sa = {0};
+    sa.sa_handler = tty_on_signal;
+    sigaction(SIGWINCH, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+
+    // alternate screen, hidden cursor
+    tty_outf("\x1b[?1049h\x1b[?25l");
+    tty_query_size();
+    return true;
+}
+
+static void tty_draw_glyph(size_t glyph, int row, int col, Tty_Cell color) {
+    for (int y = 0; y < TTY_GLYPH_HEIGHT; ++y) {
+        if (row + y < 0 || row + y >= tty.rows) continue;
+        for (int x = 0; x < TTY_GLYPH_WIDTH * TTY_PIXEL_WIDTH; ++x) {
+            if (col + x < 0 || col + x >= tty.cols) continue;
+            if (tty_glyphs[glyph][y][x / TTY_PIXEL_WIDTH] == '#') {
+                tty.back[row + y][col + x] = color;
+            }
+        }
+    }
+}
+
+static void tty_draw_time(float time, int pen_y, Tty_Cell color) {
+    const size_t t = (size_t) floorf(fmaxf(time, 0.0f));
+    const size_t hours = t / 60 / 60;
+    const size_t minutes = t / 60 % 60;
+    const size_t seconds = t % 60;
+    const size_t glyphs[CHARS_COUNT] = {
+        hours / 10, hours % 10, COLON_INDEX,
+        minutes / 10, minutes % 10, COLON_INDEX,
+        seconds / 10, seconds % 10,
+    };
+
+    int pen_x = tty.cols / 2 - TTY_TEXT_WIDTH / 2;
+    for (size_t i = 0; i < CHARS_COUNT; ++i) {
+        tty_draw_glyph(glyphs[i], pen_y, pen_x, color);
+        pen_x += TTY_GLYPH_WIDTH * TTY_PIXEL_WIDTH + TTY_GLYPH_GAP;
+    }
+}
+
+static void tty_draw_state(const State *state) {
+    memset(tty.back, 0, sizeof(tty.back));
+
+    // Terminals are narrow, so several time zones are stacked instead of side by side
+    const int clocks = (int) state_times_count(state);
+    const int block_height = TTY_GLYPH_HEIGHT + 1;
+    int pen_y = tty.rows / 2 - (clocks * block_height - 1) / 2;
+    Tty_Cell color = state->paused ? TTY_CELL_PAUSE : TTY_CELL_MAIN;
+    for (int i = 0; i < clocks; ++i) {
+        tty_draw_time(state_time_at(state, (size_t) i), pen_y, color);
+        pen_y += block_height;
+    }
+}
+
+// Appends the escape sequences that turn front into back, then sends them in one write()
+static void tty_present(void) {
+    for (int y = 0; y < tty.rows; ++y) {
+        for (int x = 0; x < tty.cols; ++x) {
+            Tty_Cell cell = tty.back[y][x];
+            if (cell == tty.front[y][x]) continue;
+
+            if (tty.cursor_row != y || tty.cursor_col != x) {
+                tty_outf("\x1b[%d;%dH", y + 1, x + 1);
+            }
+            if (cell == TTY_CELL_BLANK) {
+                tty_out(" ", 1);
+            } else {
+                if (tty.pen != cell) {
+                    if (cell == TTY_CELL_PAUSE) {
+                        tty_outf("\x1b[38;2;%d;%d;%dm", PAUSE_COLOR_R, PAUSE_COLOR_G, PAUSE_COLOR_B);
+                    } else {
+                        tty_outf("\x1b[38;2;%d;%d;%dm", MAIN_COLOR_R, MAIN_COLOR_G, MAIN_COLOR_B);
+                    }
+                    tty.pen = cell;
+                }
+                tty_out(TTY_BLOCK, sizeof(TTY_BLOCK) - 1);
+            }
+            tty.front[y][x] = cell;
+            tty.cursor_row = y;
+            tty.cursor_col = x + 1;
+        }
+    }
+    if (tty.out_size > 0) tty_flush();
+}
+
+// Milliseconds until the displayed second changes, -1 when it never will on its own
+static int tty_ms_until_next_second(const State *state) {
+    if (state->paused) return -1;
+
+    float frac;
+    switch (state->mode) {
+        case MODE_COUNTDOWN:
+            if (state->displayed_time <= 1e-6f) return state->exit_after_countdown ? 0 : -1;
+            frac = state->displayed_time - floorf(state->displayed_time);
+            break;
+        case MODE_CLOCK: {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            frac = 1.0f - ts.tv_nsec / 1e9f;
+        } break;
+        case MODE_ASCENDING:
+        default:
+            frac = 1.0f - (state->displayed_time - floorf(state->displayed_time));
+            break;
+    }
+    // land just past the boundary rather than just before it
+    return (int) ceilf(frac * 1000.0f) + 1;
+}
+
+static void tty_handle_input(State *state) {
+    char keys[64];
+    ssize_t n = read(STDIN_FILENO, keys, sizeof(keys));
+    for (ssize_t i = 0; i < n; ++i) {
+        switch (keys[i]) {
+            case ' ': state->paused = !state->paused; break;
+            case 'q': tty_quit = 1;                   break;
+        }
+    }
+}
+
+int tty_main(State *state) {
+    if (!tty_begin()) return 1;
+
+    struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+    if (!frame_clock_init(state->suspend, state->clock)) return 1;
+
+    while (!tty_quit && !state->quit) {
+        if (tty_resized) {
+            tty_resized = 0;
+            tty_query_size();
+        }
+
+        tty_draw_state(state);
+        tty_present();
+
+        int timeout = tty_ms_until_next_second(state);
+        int ready = poll(&pfd, isatty(STDIN_FILENO) ? 1 : 0, timeout);
+        if (ready > 0 && (pfd.revents & POLLIN)) tty_handle_input(state);
+
+        float suspended;
+        float dt = frame_clock_tick(&suspended);
+        if (suspended > 0.0f) state_skip(state, suspended);
+        state_update(state, dt);
+        expiry_update(state);
+        checkpoint_update(state);
+    }
+
+    frame_clock_end();
+    tty_restore();
+    return 0;
+}
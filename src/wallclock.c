@@ -0,0 +1,171 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+// Wall clock engine for MODE_CLOCK. libc is only consulted when something
+// actually changes: the UTC offset of every zone is cached together with the
+// moment of its next transition (found once by probing), and the current wall
+// time is CLOCK_REALTIME sampled once and carried forward on CLOCK_BOOTTIME
+// (which, unlike CLOCK_MONOTONIC, keeps running while the machine is suspended).
+// A CLOCK_REALTIME timerfd armed with TFD_TIMER_CANCEL_ON_SET tells us when
+// somebody steps the system clock, which is the only time we re-anchor.
+
+#define WALL_CLOCK_ZONES_CAP 4
+#define WALL_CLOCK_PROBE_STEP_S (24 * 60 * 60)
+#define WALL_CLOCK_PROBE_HORIZON_S (400 * 24 * 60 * 60)
+#define SECONDS_PER_DAY (24 * 60 * 60)
+
+typedef struct {
+    const char *tz;            // NULL for the local zone
+    int64_t utc_offset_s;
+    int64_t next_transition_s; // utc_offset_s is valid until this UTC second
+} Wall_Clock_Zone;
+
+typedef struct {
+    int initialized;
+    int64_t realtime_base_ns;
+    int64_t boottime_base_ns;
+    int64_t last_poll_s;
+    int cancel_fd;
+    Wall_Clock_Zone zones[WALL_CLOCK_ZONES_CAP];
+    size_t zones_count;
+    size_t syncs; // how many times libc time zone code ran
+} Wall_Clock;
+
+static Wall_Clock wall_clock = {.cancel_fd = -1};
+
+static int64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int64_t utc_offset_at(time_t t) {
+    struct tm tm;
+    if (!localtime_r(&t, &tm)) return 0;
+    return tm.tm_gmtoff;
+}
+
+// Finds the current offset of the zone and the UTC second at which it next changes
+static void wall_clock_sync_zone(Wall_Clock_Zone *zone, int64_t now_s) {
+    char saved_tz[256] = {0};
+    const char *env_tz = getenv("TZ");
+    int had_tz = env_tz != NULL;
+    if (zone->tz) {
+        if (had_tz) snprintf(saved_tz, sizeof(saved_tz), "%s", env_tz);
+        setenv("TZ", zone->tz, 1);
+    }
+    tzset();
+
+    int64_t offset = utc_offset_at((time_t) now_s);
+    int64_t lo = now_s, hi = now_s + WALL_CLOCK_PROBE_HORIZON_S;
+    for (int64_t t = now_s + WALL_CLOCK_PROBE_STEP_S; t < now_s + WALL_CLOCK_PROBE_HORIZON_S; t += WALL_CLOCK_PROBE_STEP_S) {
+        if (utc_offset_at((time_t) t) != offset) {
+            hi = t;
+            break;
+        }
+        lo = t;
+    }
+    if (hi < now_s + WALL_CLOCK_PROBE_HORIZON_S) {
+        // bisect down to the exact second of the transition
+        while (hi - lo > 1) {
+            int64_t mid = lo + (hi - lo) / 2;
+            if (utc_offset_at((time_t) mid) == offset) lo = mid;
+            else hi = mid;
+        }
+    }
+    zone->utc_offset_s = offset;
+    zone->next_transition_s = hi;
+
+    if (zone->tz) {
+        if (had_tz) setenv("TZ", saved_tz, 1);
+        else unsetenv("TZ");
+        tzset();
+    }
+    wall_clock.syncs++;
+}
+
+static void wall_clock_anchor(void) {
+    // bracket the realtime sample between two boottime ones to pair them tightly
+    int64_t boot_before = clock_ns(CLOCK_BOOTTIME);
+    int64_t real = clock_ns(CLOCK_REALTIME);
+    int64_t boot_after = clock_ns(CLOCK_BOOTTIME);
+    wall_clock.realtime_base_ns = real;
+    wall_clock.boottime_base_ns = boot_before + (boot_after - boot_before) / 2;
+
+    if (wall_clock.cancel_fd >= 0) {
+        // Never expires on its own, only gets cancelled when the clock is set
+        struct itimerspec its = {0};
+        its.it_value.tv_sec = (time_t) (real / 1000000000) + 10 * 365 * (time_t) SECONDS_PER_DAY;
+        timerfd_settime(wall_clock.cancel_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &its, NULL);
+    }
+}
+
+static void wall_clock_sync(void) {
+    wall_clock_anchor();
+    int64_t now_s = wall_clock.realtime_base_ns / 1000000000;
+    for (size_t i = 0; i < wall_clock.zones_count; ++i) {
+        wall_clock_sync_zone(&wall_clock.zones[i], now_s);
+    }
+    wall_clock.last_poll_s = now_s;
+}
+
+void wall_clock_init(const char **zones, size_t zones_count) {
+    wall_clock.zones_count = 0;
+    if (zones_count == 0) {
+        wall_clock.zones[wall_clock.zones_count++] = (Wall_Clock_Zone) {0};
+    }
+    for (size_t i = 0; i < zones_count && i < WALL_CLOCK_ZONES_CAP; ++i) {
+        wall_clock.zones[wall_clock.zones_count++] = (Wall_Clock_Zone) {.tz = zones[i]};
+    }
+
+    if (wall_clock.cancel_fd < 0) {
+        wall_clock.cancel_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (wall_clock.cancel_fd < 0) {
+            fprintf(stderr, "WARNING: could not create clock change timer, clock steps will go unnoticed: %s\n", strerror(errno));
+        }
+    }
+    wall_clock_sync();
+    wall_clock.initialized = 1;
+}
+
+// Re-anchors when the system clock was stepped since the last call
+static bool wall_clock_check_stepped(void) {
+    if (wall_clock.cancel_fd < 0) return false;
+    uint64_t expirations;
+    if (read(wall_clock.cancel_fd, &expirations, sizeof(expirations)) < 0 && errno == ECANCELED) {
+        wall_clock_sync();
+        return true;
+    }
+    return false;
+}
+
+// Current wall time in UTC nanoseconds, no libc time zone work involved
+int64_t wall_clock_now_ns(void) {
+    int64_t now_ns = wall_clock.realtime_base_ns + clock_ns(CLOCK_BOOTTIME) - wall_clock.boottime_base_ns;
+    int64_t now_s = now_ns / 1000000000;
+
+    // The cancel timerfd costs a syscall, so it is looked at once per second only
+    if (now_s != wall_clock.last_poll_s) {
+        wall_clock.last_poll_s = now_s;
+        if (wall_clock_check_stepped()) {
+            now_ns = wall_clock.realtime_base_ns + clock_ns(CLOCK_BOOTTIME) - wall_clock.boottime_base_ns;
+            now_s = now_ns / 1000000000;
+        }
+    }
+    for (size_t i = 0; i < wall_clock.zones_count; ++i) {
+        if (now_s >= wall_clock.zones[i].next_transition_s) wall_clock_sync_zone(&wall_clock.zones[i], now_s);
+    }
+    return now_ns;
+}
+
+float wall_clock_seconds_of_day(size_t zone, int64_t now_ns) {
+    int64_t local_ns = now_ns + wall_clock.zones[zone].utc_offset_s * 1000000000;
+    int64_t day_ns = (int64_t) SECONDS_PER_DAY * 1000000000;
+    int64_t of_day_ns = ((local_ns % day_ns) + day_ns) % day_ns;
+    return (float) ((double) of_day_ns / 1e9);
+}
@@ -0,0 +1,102 @@
+// X request budget for the window. Title and fullscreen changes are recorded
+// as desired state and diffed against what the server was last sent; the
+// difference goes out as one batch with a single XFlush, at most once per
+// displayed second. A fullscreen toggle is a user action and is sent on the
+// next frame instead of waiting for the boundary, still inside that frame's
+// batch. The sequence number of the X connection is sampled at every frame
+// start, which counts all requests of a frame, including those of GLX. With
+// `--xcb` Xlib only learns about XCB's requests when it takes the connection
+// back, so the per-frame numbers are lumpier there while the total still holds.
+
+typedef struct {
+    RGFW_window *win;
+    char title[TITLE_CAP];
+    char sent_title[TITLE_CAP];
+    int fullscreen;
+    int sent_fullscreen;
+    int urgent; // a change the user is waiting for
+    long long last_batch_second;
+    unsigned long frame_start_request;
+    uint64_t frames;
+    uint64_t requests;
+    uint64_t max_frame_requests;
+    uint64_t batches;
+} X_Batch;
+
+static X_Batch x_batch = {0};
+
+void x_batch_begin(RGFW_window *win, const char *title) {
+    x_batch.win = win;
+    snprintf(x_batch.title, sizeof(x_batch.title), "%s", title);
+    memcpy(x_batch.sent_title, x_batch.title, TITLE_CAP);
+    x_batch.fullscreen = x_batch.sent_fullscreen = (win->_flags & RGFW_windowFullscreen) != 0;
+    x_batch.last_batch_second = LLONG_MIN;
+    x_batch.frame_start_request = XNextRequest(win->src.display);
+}
+
+void x_batch_set_title(const char *title) {
+    snprintf(x_batch.title, sizeof(x_batch.title), "%s", title);
+}
+
+void x_batch_toggle_fullscreen(void) {
+    x_batch.fullscreen = !x_batch.fullscreen;
+    x_batch.urgent = 1;
+}
+
+// Accounts the requests of the previous frame
+void x_batch_begin_frame(void) {
+    unsigned long request = XNextRequest(x_batch.win->src.display);
+    uint64_t requests = request - x_batch.frame_start_request;
+    x_batch.frame_start_request = request;
+    x_batch.frames++;
+    x_batch.requests += requests;
+    if (requests > x_batch.max_frame_requests) x_batch.max_frame_requests = requests;
+}
+
+static void x_batch_send_title(void) {
+    if (xcb_window.active) {
+        xcb_window_set_title(x_batch.title);
+        memcpy(x_batch.sent_title, x_batch.title, TITLE_CAP);
+        return;
+    }
+    Display *display = x_batch.win->src.display;
+    Window window = x_batch.win->src.window;
+    RGFW_LOAD_ATOM(_NET_WM_NAME);
+    RGFW_LOAD_ATOM(UTF8_STRING);
+    // Unlike RGFW_window_setName this sends the actual length, not always 256 bytes
+    XStoreName(display, window, x_batch.title);
+    XChangeProperty(display, window, _NET_WM_NAME, UTF8_STRING, 8, PropModeReplace,
+                    (const unsigned char *) x_batch.title, (int) strlen(x_batch.title));
+    memcpy(x_batch.sent_title, x_batch.title, TITLE_CAP);
+}
+
+// Sends whatever changed, if the budget allows it in this displayed second
+void x_batch_end_frame(long long displayed_second) {
+    int title_changed = strcmp(x_batch.title, x_batch.sent_title) != 0;
+    int fullscreen_changed = x_batch.fullscreen != x_batch.sent_fullscreen;
+    if (!title_changed && !fullscreen_changed) {
+        x_batch.urgent = 0;
+        return;
+    }
+    if (!x_batch.urgent && displayed_second == x_batch.last_batch_second) return;
+
+    if (title_changed) x_batch_send_title();
+    if (fullscreen_changed) {
+        if (xcb_window.active) xcb_window_set_fullscreen(x_batch.win, x_batch.fullscreen);
+        else RGFW_window_setFullscreen(x_batch.win, (RGFW_bool) x_batch.fullscreen);
+        x_batch.sent_fullscreen = x_batch.fullscreen;
+    }
+    if (xcb_window.active) xcb_window_flush();
+    else XFlush(x_batch.win->src.display);
+    x_batch.urgent = 0;
+    x_batch.last_batch_second = displayed_second;
+    x_batch.batches++;
+}
+
+void x_batch_report(FILE *out) {
+    if (x_batch.frames == 0) return;
+    fprintf(out, "X requests         %llu in %llu frames (%.2f per frame, at most %llu), %llu batched window updates\n",
+            (unsigned long long) x_batch.requests, (unsigned long long) x_batch.frames,
+            (double) x_batch.requests / x_batch.frames, (unsigned long long) x_batch.max_frame_requests,
+            (unsigned long long) x_batch.batches);
+}
@@ -0,0 +1,335 @@
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h> // xcb_poll_for_reply
+
+// XCB path for the few window operations the timer needs (`--xcb`): event
+// polling, title, fullscreen and resize. RGFW still creates the window and the
+// GLX context; after that XCB takes over the event queue of the very same
+// connection. Requests are only queued, nothing ever waits for a reply: the
+// atoms are interned up front and their replies are picked up by
+// xcb_poll_for_reply as they arrive, so a remote or busy X server costs
+// latency only where a reply is really needed, never on the frame path.
+// Events are translated into win->event, so the main loop stays the same.
+
+#define XCB_WINDOW_HELD_CAP 64
+
+typedef enum {
+    XCB_WINDOW_NET_WM_NAME = 0,
+    XCB_WINDOW_UTF8_STRING,
+    XCB_WINDOW_NET_WM_STATE,
+    XCB_WINDOW_NET_WM_STATE_FULLSCREEN,
+    XCB_WINDOW_WM_PROTOCOLS,
+    XCB_WINDOW_WM_DELETE_WINDOW,
+    COUNT_XCB_WINDOW_ATOMS,
+} Xcb_Window_Atom;
+
+static const char *xcb_atom_names[COUNT_XCB_WINDOW_ATOMS] = {
+    [XCB_WINDOW_NET_WM_NAME]             = "_NET_WM_NAME",
+    [XCB_WINDOW_UTF8_STRING]             = "UTF8_STRING",
+    [XCB_WINDOW_NET_WM_STATE]            = "_NET_WM_STATE",
+    [XCB_WINDOW_NET_WM_STATE_FULLSCREEN] = "_NET_WM_STATE_FULLSCREEN",
+    [XCB_WINDOW_WM_PROTOCOLS]            = "WM_PROTOCOLS",
+    [XCB_WINDOW_WM_DELETE_WINDOW]        = "WM_DELETE_WINDOW",
+};
+
+typedef struct {
+    int active;
+    xcb_connection_t *conn;
+    xcb_window_t window;
+    xcb_window_t root;
+    xcb_atom_t atoms[COUNT_XCB_WINDOW_ATOMS];
+    unsigned int atom_requests[COUNT_XCB_WINDOW_ATOMS]; // sequence numbers of the replies still in flight
+    size_t atoms_pending;
+    bool move_pending; // a ConfigureNotify both resized and moved, the move is reported next
+    xcb_generic_event_t *held[XCB_WINDOW_HELD_CAP]; // read by window_pending_visible, not handled yet
+    size_t held_first;
+    size_t held_count;
+} Xcb_Window;
+
+static int window_fully_obscured = 0; // from VisibilityNotify, for either backend
+
+static Xcb_Window xcb_window = {0};
+
+// Picks up the atom replies that arrived, without blocking
+static void xcb_window_collect_replies(void) {
+    for (size_t i = 0; i < COUNT_XCB_WINDOW_ATOMS && xcb_window.atoms_pending > 0; ++i) {
+        if (xcb_window.atom_requests[i] == 0) continue;
+        void *reply = NULL;
+        xcb_generic_error_t *error = NULL;
+        if (!xcb_poll_for_reply(xcb_window.conn, xcb_window.atom_requests[i], &reply, &error)) continue;
+        if (reply) xcb_window.atoms[i] = ((xcb_intern_atom_reply_t *) reply)->atom;
+        free(reply);
+        free(error);
+        xcb_window.atom_requests[i] = 0;
+        xcb_window.atoms_pending--;
+    }
+}
+
+// Blocks for one atom, only when it is needed before its reply came in
+static xcb_atom_t xcb_window_atom(Xcb_Window_Atom atom) {
+    if (xcb_window.atom_requests[atom] != 0) {
+        xcb_intern_atom_cookie_t cookie = {xcb_window.atom_requests[atom]};
+        xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(xcb_window.conn, cookie, NULL);
+        if (reply) xcb_window.atoms[atom] = reply->atom;
+        free(reply);
+        xcb_window.atom_requests[atom] = 0;
+        xcb_window.atoms_pending--;
+    }
+    return xcb_window.atoms[atom];
+}
+
+bool xcb_window_begin(RGFW_window *win) {
+    Display *display = win->src.display;
+    xcb_window.conn = XGetXCBConnection(display);
+    if (!xcb_window.conn) {
+        fprintf(stderr, "WARNING: the X connection has no XCB side, staying on Xlib\n");
+        return false;
+    }
+    // Let RGFW handle whatever Xlib has queued already, then hand the queue to XCB
+    while (XPending(display)) RGFW_window_checkEvent(win);
+    XSetEventQueueOwner(display, XCBOwnsEventQueue);
+
+    xcb_window.window = (xcb_window_t) win->src.window;
+    xcb_window.root = xcb_setup_roots_iterator(xcb_get_setup(xcb_window.conn)).data->root;
+    for (size_t i = 0; i < COUNT_XCB_WINDOW_ATOMS; ++i) {
+        xcb_window.atom_requests[i] = xcb_intern_atom(xcb_window.conn, 0, (uint16_t) strlen(xcb_atom_names[i]), xcb_atom_names[i]).sequence;
+    }
+    xcb_window.atoms_pending = COUNT_XCB_WINDOW_ATOMS;
+    xcb_flush(xcb_window.conn);
+    xcb_window.active = 1;
+    return true;
+}
+
+int xcb_window_fd(void) {
+    return xcb_get_file_descriptor(xcb_window.conn);
+}
+
+void xcb_window_set_title(const char *title) {
+    uint32_t size = (uint32_t) strlen(title);
+    xcb_change_property(xcb_window.conn, XCB_PROP_MODE_REPLACE, xcb_window.window, XCB_ATOM_WM_NAME,
+                        XCB_ATOM_STRING, 8, size, title);
+    xcb_change_property(xcb_window.conn, XCB_PROP_MODE_REPLACE, xcb_window.window, xcb_window_atom(XCB_WINDOW_NET_WM_NAME),
+                        xcb_window_atom(XCB_WINDOW_UTF8_STRING), 8, size, title);
+}
+
+void xcb_window_set_fullscreen(RGFW_window *win, bool fullscreen) {
+    if (fullscreen) {
+        win->_flags |= RGFW_windowFullscreen;
+        win->_oldRect = win->r;
+    } else {
+        win->_flags &= ~(u32) RGFW_windowFullscreen;
+    }
+
+    // EWMH: ask the window manager through the root window
+    xcb_client_message_event_t event = {0};
+    event.response_type = XCB_CLIENT_MESSAGE;
+    event.format = 32;
+    event.window = xcb_window.window;
+    event.type = xcb_window_atom(XCB_WINDOW_NET_WM_STATE);
+    event.data.data32[0] = fullscreen ? 1 : 0; // _NET_WM_STATE_ADD or _NET_WM_STATE_REMOVE
+    event.data.data32[1] = xcb_window_atom(XCB_WINDOW_NET_WM_STATE_FULLSCREEN);
+    event.data.data32[3] = 1; // source indication: normal application
+    xcb_send_event(xcb_window.conn, 0, xcb_window.root,
+                   XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY, (const char *) &event);
+}
+
+void xcb_window_resize(int width, int height) {
+    const uint32_t values[] = {(uint32_t) width, (uint32_t) height};
+    xcb_configure_window(xcb_window.conn, xcb_window.window, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
+}
+
+void xcb_window_flush(void) {
+    xcb_flush(xcb_window.conn);
+}
+
+static void xcb_window_update_mods(RGFW_window *win, uint16_t state) {
+    RGFW_updateKeyModsPro(win, (state & XCB_MOD_MASK_LOCK) != 0, (state & XCB_MOD_MASK_2) != 0,
+                          (state & XCB_MOD_MASK_CONTROL) != 0, (state & XCB_MOD_MASK_1) != 0,
+                          (state & XCB_MOD_MASK_SHIFT) != 0, (state & XCB_MOD_MASK_4) != 0,
+                          (state & XCB_MOD_MASK_3) != 0);
+}
+
+// Pointer motion and crossing: RGFW always selects them, the timer never looks at them
+static bool window_event_ignored(int type) {
+    return type == MotionNotify || type == EnterNotify || type == LeaveNotify;
+}
+
+// Events that change the picture or the frame rate, worth drawing a frame
+// before the frame timer. The XCB event codes are the core protocol ones.
+static bool window_event_visible(int type) {
+    switch (type) {
+        case KeyPress:
+        case ButtonPress:
+        case Expose:
+        case ConfigureNotify:
+        case MapNotify:
+        case UnmapNotify:
+        case FocusIn:
+        case FocusOut:
+        case VisibilityNotify:
+        case ClientMessage:
+            return true;
+        default:
+            return refresh.randr && (type == refresh.event_base + RRScreenChangeNotify || type == refresh.event_base + RRNotify);
+    }
+}
+
+// Events read ahead by xcb_window_pending_visible come first, they are older
+static xcb_generic_event_t *xcb_window_next_event(void) {
+    if (xcb_window.held_first < xcb_window.held_count) return xcb_window.held[xcb_window.held_first++];
+    xcb_window.held_first = xcb_window.held_count = 0;
+    return xcb_poll_for_event(xcb_window.conn);
+}
+
+// XCB cannot peek, so the events are read into `held` for the next frame
+static bool xcb_window_pending_visible(void) {
+    bool visible = false;
+    for (size_t i = xcb_window.held_first; i < xcb_window.held_count; ++i) {
+        visible |= window_event_visible(xcb_window.held[i]->response_type & ~0x80);
+    }
+    while (xcb_window.held_count < XCB_WINDOW_HELD_CAP) {
+        xcb_generic_event_t *generic = xcb_poll_for_event(xcb_window.conn);
+        if (!generic) return visible;
+        int type = generic->response_type & ~0x80;
+        if (window_event_ignored(type)) {
+            free(generic);
+            continue;
+        }
+        visible |= window_event_visible(type);
+        xcb_window.held[xcb_window.held_count++] = generic;
+    }
+    // full, let a frame drain it
+    return true;
+}
+
+// Same contract as RGFW_window_checkEvent: &win->event while there are events, NULL after
+RGFW_event *xcb_window_check_event(RGFW_window *win) {
+    xcb_window_collect_replies();
+    if (xcb_window.move_pending) {
+        xcb_window.move_pending = false;
+        win->event.type = RGFW_windowMoved;
+        return &win->event;
+    }
+    xcb_generic_event_t *generic;
+    while ((generic = xcb_window_next_event())) {
+        win->event.type = 0;
+        win->event.scroll = 0;
+        switch (generic->response_type & ~0x80) {
+            case XCB_KEY_PRESS:
+            case XCB_KEY_RELEASE: {
+                xcb_key_press_event_t *e = (xcb_key_press_event_t *) generic;
+                win->event.type = (e->response_type & ~0x80) == XCB_KEY_PRESS ? RGFW_keyPressed : RGFW_keyReleased;
+                win->event.key = (u8) RGFW_apiKeyToRGFW(e->detail);
+                xcb_window_update_mods(win, e->state);
+            } break;
+            case XCB_BUTTON_PRESS: {
+                xcb_button_press_event_t *e = (xcb_button_press_event_t *) generic;
+                win->event.type = RGFW_mouseButtonPressed;
+                win->event.button = (u8) (e->detail - 1);
+                if (win->event.button == RGFW_mouseScrollUp) win->event.scroll = 1;
+                if (win->event.button == RGFW_mouseScrollDown) win->event.scroll = -1;
+                xcb_window_update_mods(win, e->state);
+            } break;
+            case XCB_CONFIGURE_NOTIFY: {
+                xcb_configure_notify_event_t *e = (xcb_configure_notify_event_t *) generic;
+                bool resized = e->width != win->r.w || e->height != win->r.h;
+                bool moved = e->x != win->r.x || e->y != win->r.y;
+                win->r = RGFW_RECT(e->x, e->y, e->width, e->height);
+                if (resized) {
+                    win->event.type = RGFW_windowResized;
+                    xcb_window.move_pending = moved;
+                } else if (moved) {
+                    win->event.type = RGFW_windowMoved;
+                }
+            } break;
+            case XCB_VISIBILITY_NOTIFY: {
+                xcb_visibility_notify_event_t *e = (xcb_visibility_notify_event_t *) generic;
+                window_fully_obscured = e->state == XCB_VISIBILITY_FULLY_OBSCURED;
+            } break;
+            case XCB_MAP_NOTIFY:
+                win->_flags &= ~(u32) RGFW_windowMinimize;
+                win->event.type = RGFW_windowRestored;
+                break;
+            case XCB_UNMAP_NOTIFY:
+                win->_flags |= RGFW_windowMinimize;
+                win->event.type = RGFW_windowMinimized;
+                break;
+            case XCB_FOCUS_IN:
+                win->_flags |= RGFW_windowFocus;
+                win->event.type = RGFW_focusIn;
+                break;
+            case XCB_FOCUS_OUT:
+                win->_flags &= ~(u32) RGFW_windowFocus;
+                win->event.type = RGFW_focusOut;
+                break;
+            case XCB_CLIENT_MESSAGE: {
+                xcb_client_message_event_t *e = (xcb_client_message_event_t *) generic;
+                if (e->type == xcb_window_atom(XCB_WINDOW_WM_PROTOCOLS) &&
+                    e->data.data32[0] == xcb_window_atom(XCB_WINDOW_WM_DELETE_WINDOW)) {
+                    win->event.type = RGFW_quit;
+                    RGFW_window_setShouldClose(win, RGFW_TRUE);
+                }
+            } break;
+            default:
+                refresh_randr_event(generic->response_type & ~0x80);
+                break;
+        }
+        free(generic);
+        if (win->event.type) return &win->event;
+    }
+    if (xcb_connection_has_error(xcb_window.conn)) RGFW_window_setShouldClose(win, RGFW_TRUE);
+    return NULL;
+}
+
+RGFW_event *window_check_event(RGFW_window *win) {
+    if (xcb_window.active) return xcb_window_check_event(win);
+    // RGFW drops VisibilityNotify, so it has to be fished out of the queue before RGFW sees it
+    XEvent e;
+    while (XCheckTypedWindowEvent(win->src.display, win->src.window, VisibilityNotify, &e)) {
+        window_fully_obscured = e.xvisibility.state == VisibilityFullyObscured;
+    }
+    // Same for XRandR
+    if (refresh.randr) {
+        while (XCheckTypedEvent(win->src.display, refresh.event_base + RRScreenChangeNotify, &e)) {
+            XRRUpdateConfiguration(&e);
+            refresh_randr_event(e.type);
+        }
+        while (XCheckTypedEvent(win->src.display, refresh.event_base + RRNotify, &e)) refresh_randr_event(e.type);
+    }
+    return RGFW_window_checkEvent(win);
+}
+
+// Drops pointer events and flags the visible ones in one pass over the Xlib queue
+static Bool window_scan_event(Display *display, XEvent *e, XPointer visible) {
+    (void) display;
+    if (window_event_ignored(e->type)) return True;
+    if (window_event_visible(e->type)) *(bool *) visible = true;
+    return False;
+}
+
+// Reads whatever the X connection has, so its fd stops being readable, drops
+// the pointer events and returns true when one of the rest is visible. The
+// others stay queued for the next frame.
+bool window_pending_visible(RGFW_window *win) {
+    if (xcb_window.active) return xcb_window_pending_visible();
+    bool visible = false;
+    XEvent e;
+    while (XCheckIfEvent(win->src.display, &e, window_scan_event, (XPointer) &visible)) {}
+    return visible;
+}
+
+// RGFW does not ask for visibility changes, add them to its event mask
+void window_watch_visibility(RGFW_window *win) {
+    XWindowAttributes attributes;
+    if (!XGetWindowAttributes(win->src.display, win->src.window, &attributes)) return;
+    XSelectInput(win->src.display, win->src.window, attributes.your_event_mask | VisibilityChangeMask);
+}
+
+bool window_occluded(void) {
+    return window_fully_obscured;
+}
+
+// The fd to wait on for X events, whichever side owns the queue
+int window_connection_fd(RGFW_window *win) {
+    return xcb_window.active ? xcb_window_fd() : ConnectionNumber(win->src.display);
+}